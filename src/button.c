@@ -5,6 +5,9 @@
 #include "log.h"
 
 
+#define LOG_MODULE          "button"
+
+
 #define BUTTON_DEBOUNCE_US          200000
 #define BUTTON_LONG_PRESS_TIME_US   5000000
 #define BUTTON_CLICK_DURATION_US    100000
@@ -30,7 +33,7 @@ void button_pressed(void) {
         button.last_state = false;
         button.last_press_time = current_time;
         button.long_press_alarm = add_alarm_in_us(BUTTON_LONG_PRESS_TIME_US, long_press_callback, NULL, true);
-        debug_log("Button Down\n");
+        log_debug("Button Down\n");
         if (button.down) {
             button.down();
         }
@@ -44,7 +47,7 @@ void button_released(void) {
         cancel_alarm(button.long_press_alarm);
         button.last_state = true;
         button.last_release_time = current_time;
-        debug_log("Button Up\n");
+        log_debug("Button Up\n");
         if (button.up) {
             button.up();
         }
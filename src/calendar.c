@@ -0,0 +1,129 @@
+#include <stdint.h>
+
+#include "rtc.h"
+
+
+// Calendar calculations, kept apart from the RTC driver so host tools can build them
+
+
+const uint8_t days_in_month[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+
+/**
+ * Check if given year is leap year
+ * 
+ * @param year The year
+ * @return true if the year is a leap year, false otherwise
+ */
+bool is_leap_year(int year) {
+    return ((year % 4 == 0 && year % 100 != 0) || (year % 400 == 0));
+}
+
+
+/**
+ * Get the number of days in given month
+ * 
+ * @param year The year of the month
+ * @param month The month (1~12)
+ * @return The number of days in the month
+ */
+int get_days_in_month(int year, int month) {
+    if (month == 2 && is_leap_year(year)) {
+        return 29;
+    }
+    return days_in_month[month];
+}
+
+
+/**
+ * Convert DateTime to timestamp
+ * 
+ * @param dt Pointer to DateTime struct
+ * @return The timestamp (total seconds since year 2000)
+ */
+int64_t get_total_seconds(DateTime *dt) {
+    int64_t sec = 0;
+    // Add years contribution
+    for (int y = 2000; y < dt->year; y++) {
+        sec += (is_leap_year(y) ? 366 : 365) * 86400LL;
+    }
+    // Add months contribution
+    for (int m = 1; m < dt->month; m++) {
+        sec += get_days_in_month(dt->year, m) * 86400LL;
+    }
+    // Add days, hours, minutes, seconds
+    sec += (dt->day - 1) * 86400LL + dt->hour * 3600LL + dt->min * 60LL + dt->sec;
+    return sec;
+}
+
+
+/**
+ * Convert timestamp to DateTime
+ * 
+ * @param timestamp The timestamp (total seconds since year 2000)
+ * @param dt Pointer to DateTime struct
+ * @return true if converted successful, false otherwise
+ */
+void timestamp_to_datetime(int64_t timestamp, DateTime *dt) {
+    int64_t seconds_remaining = timestamp;
+    
+    // Set initial values
+    dt->year = 2000;
+    dt->month = 1;
+    dt->day = 1;
+    dt->hour = 0;
+    dt->min = 0;
+    dt->sec = 0;
+    dt->wday = 6;
+    
+    // Calculate year
+    while (true) {
+        int days_in_year = is_leap_year(dt->year) ? 366 : 365;
+        int64_t seconds_in_year = days_in_year * 86400LL;
+        
+        if (seconds_remaining < seconds_in_year)
+            break;
+            
+        seconds_remaining -= seconds_in_year;
+        dt->year++;
+    }
+    
+    // Calculate month
+    while (true) {
+        int days_in_current_month = get_days_in_month(dt->year, dt->month);
+        int64_t seconds_in_month = days_in_current_month * 86400LL;
+        
+        if (seconds_remaining < seconds_in_month)
+            break;
+            
+        seconds_remaining -= seconds_in_month;
+        dt->month++;
+    }
+    
+    // Calculate day
+    dt->day = 1 + (int)(seconds_remaining / 86400LL);
+    seconds_remaining %= 86400LL;
+    
+    // Calculate hour
+    dt->hour = (int)(seconds_remaining / 3600LL);
+    seconds_remaining %= 3600LL;
+    
+    // Calculate minute
+    dt->min = (int)(seconds_remaining / 60LL);
+    
+    // Calculate second
+    dt->sec = (int)(seconds_remaining % 60LL);
+    
+    // Calculate weekday using Zeller's algorithm
+    int y = dt->year;
+    int m = dt->month;
+    int d = dt->day;
+    if (m < 3) {
+        m += 12;
+        y--;
+    }
+    int k = y % 100;
+    int j = y / 100;
+    int h = (d + 13*(m+1)/5 + k + k/4 + j/4 + 5*j) % 7;
+    dt->wday = (h + 6) % 7;    
+}
@@ -2,110 +2,110 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <assert.h>
 #include <pico/stdlib.h>
+#include <hardware/sync.h>
 
 #include <ff.h>
 
 #include "conf.h"
+#include "conf_store.h"
+#include "fatfs_disk.h"
+#include "i2c.h"
 #include "log.h"
 #include "main.h"
 
 
+#define LOG_MODULE          "conf"
+
+
 #define CONF_FILE_PATH          "/conf/WittyPi5.conf"
 #define CONF_FILE_MAX_SIZE      CONF_MAX_KEY_LENGTH * CONF_MAX_ITEMS + CONF_MAX_ITEMS + 32
 
 #define SUPPRESS_CONF_FILE_SAVING_US    5000000
 
+#define CONF_STORE_SAVING_DELAY_US      500000
+
+#define CONF_MAX_SUBSCRIBERS            8
+
+static_assert(CONF_COUNT <= CONF_MAX_ITEMS, "Too many configuration items for binary store");
+
 
 conf_obj_t config;
-conf_obj_t original_config;
-
-conf_obj_t default_config = {
-    .items = {
-        {.key = CONF_ADDRESS, .value = I2C_SLAVE_ADDR},
-
-        {.key = CONF_DEFAULT_ON_DELAY, .value = 255},
-        {.key = CONF_POWER_CUT_DELAY, .value = 15},
-
-        {.key = CONF_PULSE_INTERVAL, .value = 10},
-        {.key = CONF_BLINK_LED, .value = 100},
-        {.key = CONF_DUMMY_LOAD, .value = 0},
-
-        {.key = CONF_LOW_VOLTAGE, .value = 0},
-        {.key = CONF_RECOVERY_VOLTAGE, .value = 0},
-        
-        {.key = CONF_PS_PRIORITY, .value = 0},
-
-        {.key = CONF_ADJ_VUSB, .value = 0},
-        {.key = CONF_ADJ_VIN, .value = 0},
-        {.key = CONF_ADJ_VOUT, .value = 0},
-        {.key = CONF_ADJ_IOUT, .value = 0},
-        
-        {.key = CONF_WATCHDOG, .value = 0},
-        
-        {.key = CONF_LOG_TO_FILE, .value = 1},
-                
-        {.key = CONF_BOOTSEL_FTY_RST, .value = 1},
-
-        {.key = CONF_ALARM1_SECOND, .value = 0},
-        {.key = CONF_ALARM1_MINUTE, .value = 0},
-        {.key = CONF_ALARM1_HOUR, .value = 0},
-        {.key = CONF_ALARM1_DAY, .value = 0},
-
-        {.key = CONF_ALARM2_SECOND, .value = 0},
-        {.key = CONF_ALARM2_MINUTE, .value = 0},
-        {.key = CONF_ALARM2_HOUR, .value = 0},
-        {.key = CONF_ALARM2_DAY, .value = 0},
-
-        {.key = CONF_BELOW_TEMP_ACTION, .value = 0},
-        {.key = CONF_BELOW_TEMP_POINT, .value = 0},
-        {.key = CONF_OVER_TEMP_ACTION, .value = 0},
-        {.key = CONF_OVER_TEMP_POINT, .value = 0},
-        
-        {.key = CONF_DST_OFFSET, .value = 0},
-        {.key = CONF_DST_BEGIN_MON, .value = 0},
-        {.key = CONF_DST_BEGIN_DAY, .value = 0},
-        {.key = CONF_DST_BEGIN_HOUR, .value = 0},
-        {.key = CONF_DST_BEGIN_MIN, .value = 0},
-        {.key = CONF_DST_END_MON, .value = 0},
-        {.key = CONF_DST_END_DAY, .value = 0},
-        {.key = CONF_DST_END_HOUR, .value = 0},
-        {.key = CONF_DST_END_MIN, .value = 0},
-        {.key = CONF_DST_APPLIED, .value = 0},
-
-		{.key = CONF_SYS_CLOCK_MHZ, .value = 48},
-        
-        {.key = CONF_VIN_HOT_STANDBY, .value = 0},
-    },
-    .count = 40
+conf_obj_t original_config;     // Values in the file when it was synchronized last time
+
+// Tables generated from conf_items.h
+
+static const char *const conf_keys[CONF_COUNT] = {
+#define CONF_ITEM(key, name, reg, def, min, max) [key] = name,
+#include "conf_items.h"
+#undef CONF_ITEM
+};
+
+static const conf_obj_t default_config = {
+    .values = {
+#define CONF_ITEM(key, name, reg, def, min, max) [key] = def,
+#include "conf_items.h"
+#undef CONF_ITEM
+    }
+};
+
+static const uint8_t conf_min_values[CONF_COUNT] = {
+#define CONF_ITEM(key, name, reg, def, min, max) [key] = min,
+#include "conf_items.h"
+#undef CONF_ITEM
+};
+
+static const uint8_t conf_max_values[CONF_COUNT] = {
+#define CONF_ITEM(key, name, reg, def, min, max) [key] = max,
+#include "conf_items.h"
+#undef CONF_ITEM
+};
+
+// Key + 1 of the item mapped to each configuration register, 0 for none
+static const uint8_t conf_register_keys[I2C_CONF_LAST - I2C_CONF_FIRST + 1] = {
+#define CONF_ITEM(key, name, reg, def, min, max) [(reg) - I2C_CONF_FIRST] = key + 1,
+#include "conf_items.h"
+#undef CONF_ITEM
 };
 
 static bool dirty = false;
 
+static bool sync_requested = false;
+
 FILINFO disk_file_info;
 
+static uint8_t pending_values[CONF_COUNT];
+static uint64_t pending_since_us = 0;
 
-static bool conf_sanitize_bool_value(conf_obj_t *obj, const char *key, uint8_t default_value) {
-    if (!obj || !key) {
-        return false;
-    }
+static uint32_t synced_host_writes = 0;
 
-    for (int i = 0; i < obj->count; i++) {
-        if (strcmp(obj->items[i].key, key) == 0) {
-            uint8_t value = obj->items[i].value;
-            if (value != 0 && value != 1) {
-                debug_log("Invalid %s=%d, reset to default %d.\n", key, value, default_value);
-                obj->items[i].value = default_value;
-                return true;
-            }
-            return false;
-        }
-    }
+// Subscriber of configuration changes
+typedef struct {
+    uint64_t keys;                          // Bit mask of subscribed keys
+    item_changed_callback_t callback;
+} conf_subscriber_t;
 
-    return false;
+static conf_subscriber_t subscribers[CONF_MAX_SUBSCRIBERS];
+static uint8_t subscriber_count = 0;
+
+static volatile uint64_t changed_keys = 0;          // Bit mask of keys changed since last notification
+static uint8_t changed_old_values[CONF_COUNT];      // Values before the first change since last notification
+
+
+/**
+ * Check if the value is in the valid range of configuration item
+ * 
+ * @param key The item key
+ * @param value The value to check
+ * @return true if valid, false otherwise
+ */
+bool conf_is_valid_value(conf_key_t key, uint8_t value) {
+    return key < CONF_COUNT && value >= conf_min_values[key] && value <= conf_max_values[key];
 }
 
 
+// Reset invalid values to default
 static bool conf_sanitize(conf_obj_t *obj) {
     bool changed = false;
 
@@ -113,81 +113,59 @@ static bool conf_sanitize(conf_obj_t *obj) {
         return false;
     }
 
-    changed |= conf_sanitize_bool_value(obj, CONF_PS_PRIORITY, 0);
-    changed |= conf_sanitize_bool_value(obj, CONF_VIN_HOT_STANDBY, 0);
+    for (int i = 0; i < CONF_COUNT; i++) {
+        uint8_t value = obj->values[i];
+        if (!conf_is_valid_value((conf_key_t)i, value)) {
+            log_warn("Invalid %s=%d, reset to default %d.\n", conf_keys[i], value, default_config.values[i]);
+            obj->values[i] = default_config.values[i];
+            changed = true;
+        }
+    }
 
     return changed;
 }
 
 
+// Queue the change of item for subscribers, an item changed many times is notified once
+static void record_change(conf_key_t key, uint8_t old_val) {
+    uint32_t status = save_and_disable_interrupts();
+    if (!(changed_keys & (1ULL << key))) {
+        changed_old_values[key] = old_val;
+        changed_keys |= (1ULL << key);
+    }
+    restore_interrupts(status);
+}
+
+
 // Copy configuration from one to another
-bool copy_config(conf_obj_t *dest, conf_obj_t *src) {
+bool copy_config(conf_obj_t *dest, const conf_obj_t *src) {
 
     if (!dest || !src) {
         return false;
     }
 
-    for (int i = 0; i < src->count; i++) {
-        strcpy(dest->items[i].key, src->items[i].key);
-        dest->items[i].value = src->items[i].value;
-    }
-
-    dest->count = src->count;
-    
     if (dest == &config) {
+        for (int i = 0; i < CONF_COUNT; i++) {
+            if (config.values[i] != src->values[i]) {
+                record_change((conf_key_t)i, config.values[i]);
+            }
+        }
         dirty = true;
     }
-    return true;
-}
-
 
-// Add item into configuration
-bool conf_add(conf_obj_t *obj, const char *key, uint8_t value) {
-    if (obj->count >= CONF_MAX_ITEMS) return false;
-
-    conf_item_t *item = &obj->items[obj->count];
-    strncpy(item->key, key, CONF_MAX_KEY_LENGTH - 1);
-    item->key[CONF_MAX_KEY_LENGTH - 1] = '\0';
-    item->value = value;
-    obj->count++;
-    
-    if (obj == &config) {
-        dirty = true;
-    }
+    memcpy(dest->values, src->values, CONF_COUNT);
     return true;
 }
 
 
-// Remove configuration item by key
-bool conf_remove(conf_obj_t *obj, const char *key) {
-    if (obj == NULL || key == NULL) {
-        return false;
-    }
-    for (uint8_t i = 0; i < obj->count; i++) {
-        if (strcmp(obj->items[i].key, key) == 0) {
-            for (uint8_t j = i; j < obj->count - 1; j++) {
-                strcpy(obj->items[j].key, obj->items[j+1].key);
-                obj->items[j].value = obj->items[j+1].value;
-            }
-            obj->count--;
-            if (obj == &config) {
-                dirty = true;
-            }
-            return true;
+// Find configuration item by key name, return CONF_COUNT if not found
+static conf_key_t find_key(const char *name) {
+    for (int i = 0; i < CONF_COUNT; i++) {
+        if (0 == strcmp(conf_keys[i], name)) {
+            return (conf_key_t)i;
         }
     }
-    return false;
-}
-
-
-// Check if configuration contains item with given key
-bool conf_contains(conf_obj_t *obj, const char *key) {
-    for (int i = 0; i < obj->count; i++) {
-        if (0 == strcmp(obj->items[i].key, key)) {
-            return true;
-        }
-    }
-    return false;
+    return CONF_COUNT;
 }
 
 
@@ -206,8 +184,8 @@ int conf_serialize(const conf_obj_t *obj, char *buffer, uint16_t buf_size) {
     buffer[pos++] = '{';
     buffer[pos++] = '\n';
 
-    for (uint8_t i = 0; i < obj->count; i++) {
-        const conf_item_t *item = &obj->items[i];
+    for (uint8_t i = 0; i < CONF_COUNT; i++) {
+        const char *key = conf_keys[i];
 
         if (i > 0) {
             if (pos + 1 >= buf_size) return -1;
@@ -215,15 +193,15 @@ int conf_serialize(const conf_obj_t *obj, char *buffer, uint16_t buf_size) {
             buffer[pos++] = '\n';
         }
 
-        if (pos + strlen(item->key) + 3 >= buf_size) return -1;
+        if (pos + strlen(key) + 3 >= buf_size) return -1;
         buffer[pos++] = '"';
-        strcpy(&buffer[pos], item->key);
-        pos += strlen(item->key);
+        strcpy(&buffer[pos], key);
+        pos += strlen(key);
         buffer[pos++] = '"';
         buffer[pos++] = ':';
 
         if (pos + 12 >= buf_size) return -1;
-        pos += sprintf(&buffer[pos], "%u", item->value);
+        pos += sprintf(&buffer[pos], "%u", obj->values[i]);
     }
 
     if (pos + 1 >= buf_size) return -1;
@@ -259,17 +237,20 @@ static bool parse_uint8(const char **str, uint8_t *value) {
 /**
  * Parse given string as configuration
  * 
+ * Items not in the string keep their values in the configuration object
+ * 
  * @param str The string to be parsed
  * @param obj The pointer to configuration object
+ * @param changed Set to true if any item is unknown or missing in the string
  * @return true if parse succesfully, false otherwise
  */
-bool conf_parse(const char *str, conf_obj_t *obj) {
-    if (!str || !obj) {
+bool conf_parse(const char *str, conf_obj_t *obj, bool *changed) {
+    if (!str || !obj || !changed) {
         return false;
     }
 
     const char *p = str;
-    obj->count = 0;
+    bool found[CONF_COUNT] = {false};
 
     while (isspace(*p)) p++;
 
@@ -282,19 +263,15 @@ bool conf_parse(const char *str, conf_obj_t *obj) {
 
         if (*p == '}') break;
 
-        if (obj->count >= CONF_MAX_ITEMS) {
-            return false;
-        }
-        conf_item_t *item = &obj->items[obj->count];
-
         if (*p++ != '"') {
             return false;
         }
+        char name[CONF_MAX_KEY_LENGTH];
         size_t key_len = 0;
         while (*p && *p != '"' && key_len < CONF_MAX_KEY_LENGTH - 1) {
-            item->key[key_len++] = *p++;
+            name[key_len++] = *p++;
         }
-        item->key[key_len] = '\0';
+        name[key_len] = '\0';
         if (*p++ != '"') {
             return false;
         }
@@ -305,10 +282,25 @@ bool conf_parse(const char *str, conf_obj_t *obj) {
         }
         while (isspace(*p)) p++;
 
-        if (!parse_uint8(&p, &item->value)) {
+        uint8_t value;
+        if (!parse_uint8(&p, &value)) {
             return false;
         }
-        obj->count++;
+        conf_key_t key = find_key(name);
+        if (key == CONF_COUNT) {
+            log_debug("Remove configuration item: %s\n", name);
+            *changed = true;
+        } else {
+            obj->values[key] = value;
+            found[key] = true;
+        }
+    }
+
+    for (int i = 0; i < CONF_COUNT; i++) {
+        if (!found[i]) {
+            log_debug("Add configuration item: %s\n", conf_keys[i]);
+            *changed = true;
+        }
     }
 
     return *p == '}';
@@ -316,7 +308,7 @@ bool conf_parse(const char *str, conf_obj_t *obj) {
 
 
 // Load configuration from file
-bool load_from_file(const char *path, conf_obj_t *obj) {
+bool load_from_file(const char *path, conf_obj_t *obj, bool *changed) {
     if (!path || !obj) {
         return false;
     }
@@ -328,18 +320,18 @@ bool load_from_file(const char *path, conf_obj_t *obj) {
         res = f_read(&fp, data, CONF_FILE_MAX_SIZE, &data_length);
         if (res == FR_OK) {
             data[data_length] = 0;
-            if (conf_parse(data, obj)) {
+            if (conf_parse(data, obj, changed)) {
                 f_close(&fp);
                 return true;
             } else {
-                debug_log("Configuration parsing failed: %s\n", path);
+                log_error("Configuration parsing failed: %s\n", path);
             }
         } else {
-            debug_log("Read file %s failed: %d\n", path, res);
+            log_error("Read file %s failed: %d\n", path, res);
         }
         f_close(&fp);
     } else {
-        debug_log("Can't open file %s for reading: %d\n", path, res);
+        log_error("Can't open file %s for reading: %d\n", path, res);
     }
     return false;
 }
@@ -365,11 +357,11 @@ bool save_to_file(const char *path, const conf_obj_t *obj) {
             f_close(&fp);
             return true;
         } else {
-            debug_log("Write file %s failed: %d\n", path, res);
+            log_error("Write file %s failed: %d\n", path, res);
         }
         f_close(&fp);
     } else {
-        debug_log("Can't open file %s for writing: %d\n", path, res);
+        log_error("Can't open file %s for writing: %d\n", path, res);
     }
     return false;
 }
@@ -380,113 +372,208 @@ bool save_to_file(const char *path, const conf_obj_t *obj) {
  */
 void conf_init(void) {
 
-    if (!load_from_file(CONF_FILE_PATH, &config) || config.count == 0) {
+    // Binary store in flash is used if valid, so the file doesn't have to be parsed at every boot
+    if (conf_store_load(config.values, original_config.values, CONF_COUNT, &disk_file_info.fdate, &disk_file_info.ftime)) {
+        conf_sanitize(&config);
+        dirty = memcmp(config.values, original_config.values, CONF_COUNT) != 0;
+        synced_host_writes = get_fatfs_host_write_count();
+
+        // The file may have been edited on USB drive without being synchronized before reset
+        FILINFO info;
+        FRESULT res = f_stat(CONF_FILE_PATH, &info);
+        if (res != FR_OK || info.fdate != disk_file_info.fdate || info.ftime != disk_file_info.ftime) {
+            log_debug("conf file is changed since last synchronization.\n");
+            sync_requested = true;
+        }
+        return;
+    }
+    log_warn("No valid configuration store, load from file.\n");
+
+    // Items missing in file take default values
+    bool changed = false;
+    copy_config(&config, &default_config);
+    if (!load_from_file(CONF_FILE_PATH, &config, &changed)) {
         // No usable configuration loaded
-        debug_log("Restore to default configuration.\n");
+        log_warn("Restore to default configuration.\n");
         copy_config(&config, &default_config);
-        
-    } else {
-        conf_obj_t tmp_config;
-        
-        // Remove items that do not exist in default configuration
-        copy_config(&tmp_config, &config);
-        for (int i = 0; i < tmp_config.count; i++) {
-            if (!conf_contains(&default_config, tmp_config.items[i].key)) {
-                debug_log("Remove configuration item: %s\n", tmp_config.items[i].key);
-                conf_remove(&config, tmp_config.items[i].key);
-                dirty = true;
-            }
-        }
-        
-        // Add new items that exist in default configuration
-        copy_config(&tmp_config, &config);
-        for (int i = 0; i < default_config.count; i++) {
-            if (!conf_contains(&tmp_config, default_config.items[i].key)) {
-                debug_log("Add configuration item: %s\n", default_config.items[i].key);
-                conf_add(&config, default_config.items[i].key, default_config.items[i].value);
-                dirty = true;
-            }
-        }
+        changed = true;
     }
 
+    // Make an original copy
+    copy_config(&original_config, &config);
+
     // Sanitize loaded configuration values
     if (conf_sanitize(&config)) {
-        dirty = true;
+        changed = true;
     }
 
-    // Make an original copy
-    copy_config(&original_config, &config);
-    
+    // The file is written soon if it is missing or doesn't have valid values of all items
+    dirty = changed;
+    sync_requested = changed;
+
     // Backup disk file info
     f_stat(CONF_FILE_PATH, &disk_file_info);
+    synced_host_writes = get_fatfs_host_write_count();
+
+    // Values loaded at boot are not changes to notify
+    changed_keys = 0;
 }
 
 
-// Get item from configuration object
-uint8_t conf_get_from(const conf_obj_t *obj, const char *key) {
-    if (obj && key) {
-        for (int i = 0; i < obj->count; i++) {
-            if (0 == strcmp(obj->items[i].key, key)) {
-                return obj->items[i].value;
-            }
-        }
-        debug_log("Failed to get configuration with key=%s\n", key);
-    }
-    return 0;
+/**
+ * Get the key name of configuration item, as used in configuration file
+ * 
+ * @param key The item key
+ * @return The key name, or "?" for invalid key
+ */
+const char *conf_get_key_name(conf_key_t key) {
+    return key < CONF_COUNT ? conf_keys[key] : "?";
 }
 
 
 /**
- * Get configuration item
+ * Get the configuration item of I2C register
  * 
- * @param key The item key
- * @return The value of configuration item
+ * @param index The index of the register
+ * @return The item key, or CONF_COUNT if no item is mapped to the register
  */
-uint8_t conf_get(const char *key) {
-    return conf_get_from(&config, key);
+conf_key_t conf_get_key_by_register(uint8_t index) {
+    if (index < I2C_CONF_FIRST || index > I2C_CONF_LAST || conf_register_keys[index - I2C_CONF_FIRST] == 0) {
+        return CONF_COUNT;
+    }
+    return (conf_key_t)(conf_register_keys[index - I2C_CONF_FIRST] - 1);
 }
 
 
 // Set item to configuration object
-bool conf_set_to(conf_obj_t *obj, const char *key, uint8_t value) {
-    if (obj && key) {
-        for (int i = 0; i < obj->count; i++) {
-            if (0 == strcmp(obj->items[i].key, key)) {
-    			uint8_t old_val = obj->items[i].value;
-                obj->items[i].value = value;
-    			if (obj->items[i].callback) {
-    				obj->items[i].callback(key, old_val, value);
-    			}
-    			if (obj == &config) {
-                    dirty = true;
-                }
-                return true;
-            }
-        }
-        debug_log("Failed to set configuration with key=%s, value=%d\n", key, value);
+bool conf_set_to(conf_obj_t *obj, conf_key_t key, uint8_t value) {
+    if (!obj || key >= CONF_COUNT) {
+        log_error("Failed to set configuration with key=%d, value=%d\n", key, value);
+        return false;
     }
-    return false;
+    if (!conf_is_valid_value(key, value)) {
+        log_warn("Invalid %s=%d ignored.\n", conf_keys[key], value);
+        return false;
+    }
+    uint8_t old_val = obj->values[key];
+    obj->values[key] = value;
+    if (obj == &config) {
+        record_change(key, old_val);
+        dirty = true;
+    }
+    return true;
 }
 
 
 /**
- * Set configuration item
+ * Set configuration item, the value is rejected if it is out of the valid range
+ * 
+ * Subscribers are notified later in the main loop, so it is safe to call in interrupt context
  * 
  * @param key The item key
  * @param value The item value
  * @return true if succeed, false otherwise
  */
-bool conf_set(const char *key, uint8_t value) {
+bool conf_set(conf_key_t key, uint8_t value) {
     return conf_set_to(&config, key, value);
 }
 
 
+/**
+ * Set multiple configuration items at once, subscribers are notified after all values are set
+ * 
+ * @param keys The item keys
+ * @param values The item values
+ * @param count Number of items
+ * @return true if succeed, false if any key or value is invalid (nothing is set in this case)
+ */
+bool conf_set_batch(const conf_key_t *keys, const uint8_t *values, uint8_t count) {
+    if (!keys || !values) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (!conf_is_valid_value(keys[i], values[i])) {
+            log_warn("Invalid %s=%d, batch of %d items ignored.\n", conf_get_key_name(keys[i]), values[i], count);
+            return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        record_change(keys[i], config.values[keys[i]]);
+        config.values[keys[i]] = values[i];
+    }
+    if (count > 0) {
+        dirty = true;
+    }
+    return true;
+}
+
+
+/**
+ * Subscribe to the changes of configuration items
+ * 
+ * The callback is called in the main loop once for every changed item, after all changes
+ * made since last notification, with the value before them and the current value.
+ * An item changed back to its old value is not notified.
+ * 
+ * @param first The first item key to subscribe
+ * @param last The last item key to subscribe, items between first and last are subscribed too
+ * @param callback The callback function
+ * @return true if subscribed, false otherwise
+ */
+bool conf_subscribe(conf_key_t first, conf_key_t last, item_changed_callback_t callback) {
+    if (!callback || first > last || last >= CONF_COUNT) {
+        return false;
+    }
+    if (subscriber_count >= CONF_MAX_SUBSCRIBERS) {
+        log_error("Too many configuration subscribers.\n");
+        return false;
+    }
+    uint64_t keys = 0;
+    for (int i = first; i <= last; i++) {
+        keys |= (1ULL << i);
+    }
+    subscribers[subscriber_count].keys = keys;
+    subscribers[subscriber_count].callback = callback;
+    subscriber_count++;
+    return true;
+}
+
+
+// Notify subscribers of the items changed since last notification
+static void notify_changes(void) {
+    if (!changed_keys) {
+        return;
+    }
+    uint8_t old_values[CONF_COUNT];
+    uint8_t new_values[CONF_COUNT];
+    uint32_t status = save_and_disable_interrupts();
+    uint64_t keys = changed_keys;
+    changed_keys = 0;
+    memcpy(old_values, changed_old_values, CONF_COUNT);
+    memcpy(new_values, config.values, CONF_COUNT);
+    restore_interrupts(status);
+
+    for (int i = 0; i < CONF_COUNT; i++) {
+        if (!(keys & (1ULL << i)) || old_values[i] == new_values[i]) {
+            continue;
+        }
+        for (int j = 0; j < subscriber_count; j++) {
+            if (subscribers[j].keys & (1ULL << i)) {
+                subscribers[j].callback((conf_key_t)i, old_values[i], new_values[i]);
+            }
+        }
+    }
+}
+
+
 // Save configuration to file without any condition
 // This will discard any change made directly on the file in USB-Drive
 bool conf_save(void) {
     if (dirty) {
     	if (save_to_file(CONF_FILE_PATH, &config)) {
             dirty = false;
+            copy_config(&original_config, &config);
             return true;
         }
     }
@@ -498,57 +585,107 @@ bool conf_save(void) {
  * Reset the configuration to default values
  */
 void conf_reset(void) {
-    debug_log("Reset configuration.\n");
+    log_info("Reset configuration.\n");
     copy_config(&config, &default_config);
-    copy_config(&original_config, &config);
-    dirty = false;
+    dirty = true;
+    sync_requested = true;
 }
 
 
 /**
  * Synchronize the configuration in RAM with the data in file
+ * 
+ * Changes made on the file are loaded, then the file is written if configuration in RAM
+ * is different, the binary store remembers what the file has after that
  */
 void conf_sync(void) {
     FILINFO new_info;
     FRESULT res = f_stat(CONF_FILE_PATH, &new_info);
+    synced_host_writes = get_fatfs_host_write_count();
+    sync_requested = false;
+    if (res == FR_NO_FILE) {
+        dirty = true;   // Export the configuration to file again
+    }
     if (res == FR_OK && (new_info.fdate != disk_file_info.fdate || new_info.ftime != disk_file_info.ftime)) {
-        debug_log("conf file is changed.\n");
-        conf_obj_t disk_config;
-        if (load_from_file(CONF_FILE_PATH, &disk_config) && disk_config.count != 0) {
+        log_debug("conf file is changed.\n");
+
+        // Items missing in file keep the values in RAM
+        conf_obj_t disk_config = config;
+        bool changed = false;
+        if (load_from_file(CONF_FILE_PATH, &disk_config, &changed)) {
+            conf_obj_t file_config = disk_config;
             if (dirty) {
-                debug_log("RAM conf is changed.\n");
-                for (int i = 0; i < config.count; i++) {
-                    char * key = config.items[i].key;
-                    uint8_t value = config.items[i].value;
-                    
-                    if (!conf_contains(&disk_config, key)) {
-                        conf_add(&disk_config, key, value);
-                    } else if (conf_get_from(&original_config, key) != value) {
-                        conf_set_to(&disk_config, key, value);
+                log_debug("RAM conf is changed.\n");
+                for (int i = 0; i < CONF_COUNT; i++) {
+                    if (original_config.values[i] != config.values[i]) {
+                        disk_config.values[i] = config.values[i];
                     }
                 }
             }
-            if (conf_sanitize(&disk_config)) {
-                dirty = true;
-            }
+            conf_sanitize(&disk_config);
             copy_config(&config, &disk_config);
+            copy_config(&original_config, &file_config);
+            dirty = changed || memcmp(config.values, original_config.values, CONF_COUNT) != 0;
+            disk_file_info = new_info;
         }
     }
     if (conf_save()) {
         if (f_stat(CONF_FILE_PATH, &disk_file_info) == FR_OK) {
-            debug_log("conf file info updated.\n");
+            log_debug("conf file info updated.\n");
         }
     }
+    conf_save_binary();
 }
 
 
 /**
- * Save configuration to file when:
- *   the "dirty" flag is set, and
+ * Save configuration into binary store in flash, if it has been changed
+ * 
+ * Changed values are appended to the journal of store, the file is not written
+ * 
+ * @return true if saved, false otherwise
+ */
+bool conf_save_binary(void) {
+    int changes = conf_store_save(config.values, original_config.values, CONF_COUNT, disk_file_info.fdate, disk_file_info.ftime);
+    if (changes < 0) {
+        log_error("Failed to save configuration store.\n");
+        return false;
+    }
+    return changes > 0;
+}
+
+
+/**
+ * Check if the configuration file needs to be synchronized
+ * 
+ * Changes made in RAM alone don't need it, they are kept in binary store and written into
+ * file when synchronization is requested (e.g. by admin command)
+ * 
+ * @return true if the disk has been changed since last synchronization, or the file needs to be rewritten
+ */
+bool conf_is_sync_needed(void) {
+    return sync_requested || synced_host_writes != get_fatfs_host_write_count();
+}
+
+
+/**
+ * Notify subscribers of changed items,
+ * save configuration to binary store when values stay unchanged for a while,
+ * and synchronize with file when:
+ *   the disk has been changed by USB host or the file needs to be rewritten, and
  *   the USB drive is not mounted or ejected
  */
 void process_conf_task(void) {
-    if (dirty) {
+    notify_changes();
+
+    if (memcmp(config.values, pending_values, CONF_COUNT) != 0) {
+        memcpy(pending_values, config.values, CONF_COUNT);
+        pending_since_us = get_absolute_time();
+    } else if (get_absolute_time() - pending_since_us >= CONF_STORE_SAVING_DELAY_US) {
+        conf_save_binary();
+    }
+
+    if (conf_is_sync_needed()) {
         if (get_absolute_time() >= SUPPRESS_CONF_FILE_SAVING_US && !is_usb_msc_device_mounted()) {
             conf_sync();
         }
@@ -575,20 +712,3 @@ bool is_shutdown_alarm_configured(void) {
     return conf_get(CONF_ALARM2_DAY) != 0;
 }
 
-
-/**
- * Register callback function for item changed
- * 
- * @param key The item key
- * @param callback The pointer for callback function, NULL for unregisteration
- * @return true if succeed, false otherwise
- */
-bool register_item_changed_callback(const char *key, item_changed_callback_t callback) {
-	for (int i = 0; i < config.count; i++) {
-        if (0 == strcmp(config.items[i].key, key)) {
-			config.items[i].callback = callback;
-			return true;
-		}
-	}
-    return false;
-}
\ No newline at end of file
@@ -0,0 +1,76 @@
+// Schema of configuration items, included where tables are generated from it:
+//
+//   CONF_ITEM(key, name, reg, def, min, max)
+//
+//   key     Key id, also the index of value in binary store: items must not be reordered,
+//           new items are added at the end
+//   name    Key name in configuration file
+//   reg     I2C register of the item (I2C_CONF_FIRST ~ I2C_CONF_LAST)
+//   def     Default value
+//   min     Minimum valid value
+//   max     Maximum valid value
+//
+// Reactions to changed values are not part of the schema: modules subscribe to keys with
+// conf_subscribe() in their init functions, so conf.c does not depend on them.
+//
+// No include guard: the includer defines CONF_ITEM before including and undefines it after.
+
+CONF_ITEM(CONF_ADDRESS,            "ADDRESS",           0x10, I2C_SLAVE_ADDR, 0, 255)  // I2C slave address: defaul=0x51
+
+CONF_ITEM(CONF_DEFAULT_ON_DELAY,   "DEFAULT_ON_DELAY",  0x11, 255,            0, 255)  // The delay (in second) between power connection and turning on Pi: default=255(off)
+CONF_ITEM(CONF_POWER_CUT_DELAY,    "POWER_CUT_DELAY",   0x12, 15,             0, 255)  // The delay (in second) between Pi shutdown and power cut: default=15
+
+CONF_ITEM(CONF_PULSE_INTERVAL,     "PULSE_INTERVAL",    0x13, 10,             0, 255)  // Pulse interval in seconds, for LED and dummy load: default=5
+CONF_ITEM(CONF_BLINK_LED,          "BLINK_LED",         0x14, 100,            0, 255)  // How long the white LED should stay on (in ms), 0 if white LED should not blink.
+CONF_ITEM(CONF_DUMMY_LOAD,         "DUMMY_LOAD",        0x15, 0,              0, 255)  // How long the dummy load should be applied (in ms), 0 if dummy load is off.
+
+CONF_ITEM(CONF_LOW_VOLTAGE,        "LOW_VOLTAGE",       0x16, 0,              0, 255)  // Low voltage threshold (x10), 0=disabled
+CONF_ITEM(CONF_RECOVERY_VOLTAGE,   "RECOVERY_VOLTAGE",  0x17, 0,              0, 255)  // Voltage (x10) that triggers recovery, 0=disabled
+
+CONF_ITEM(CONF_PS_PRIORITY,        "PS_PRIORITY",       0x18, 0,              0, 1)    // Power source priority, 0=Vusb first, 1=Vin first
+
+CONF_ITEM(CONF_ADJ_VUSB,           "ADJ_VUSB",          0x19, 0,              0, 255)  // Adjustment for measured Vusb (x100), range from -127 to 127
+CONF_ITEM(CONF_ADJ_VIN,            "ADJ_VIN",           0x1A, 0,              0, 255)  // Adjustment for measured Vin (x100), range from -127 to 127
+CONF_ITEM(CONF_ADJ_VOUT,           "ADJ_VOUT",          0x1B, 0,              0, 255)  // Adjustment for measured Vout (x100), range from -127 to 127
+CONF_ITEM(CONF_ADJ_IOUT,           "ADJ_IOUT",          0x1C, 0,              0, 255)  // Adjustment for measured Iout (x1000), range from -127 to 127
+
+CONF_ITEM(CONF_WATCHDOG,           "WATCHDOG",          0x1D, 0,              0, 255)  // Allowed missing heartbeats before power cycle by watchdog, default=0(disable watchdog)
+
+CONF_ITEM(CONF_LOG_TO_FILE,        "LOG_TO_FILE",       0x1E, 1,              0, 1)    // Whether to write log into file: 1=allowed, 0=not allowed
+
+CONF_ITEM(CONF_BOOTSEL_FTY_RST,    "BOOTSEL_FTY_RST",   0x1F, 1,              0, 1)    // Whether to allow long press BOOTSEL and then click button for factory reset: 1=allowed, 0=not allowed
+
+CONF_ITEM(CONF_ALARM1_SECOND,      "ALARM1_SECOND",     0x20, 0,              0, 255)  // Second_alarm register for startup alarm (BCD format)
+CONF_ITEM(CONF_ALARM1_MINUTE,      "ALARM1_MINUTE",     0x21, 0,              0, 255)  // Minute_alarm register for startup alarm (BCD format)
+CONF_ITEM(CONF_ALARM1_HOUR,        "ALARM1_HOUR",       0x22, 0,              0, 255)  // Hour_alarm register for startup alarm (BCD format)
+CONF_ITEM(CONF_ALARM1_DAY,         "ALARM1_DAY",        0x23, 0,              0, 255)  // Day_alarm register for startup alarm (BCD format)
+
+CONF_ITEM(CONF_ALARM2_SECOND,      "ALARM2_SECOND",     0x24, 0,              0, 255)  // Second_alarm register for shutdown alarm (BCD format)
+CONF_ITEM(CONF_ALARM2_MINUTE,      "ALARM2_MINUTE",     0x25, 0,              0, 255)  // Minute_alarm register for shutdown alarm (BCD format)
+CONF_ITEM(CONF_ALARM2_HOUR,        "ALARM2_HOUR",       0x26, 0,              0, 255)  // Hour_alarm register for shutdown alarm (BCD format)
+CONF_ITEM(CONF_ALARM2_DAY,         "ALARM2_DAY",        0x27, 0,              0, 255)  // Day_alarm register for shutdown alarm (BCD format)
+
+CONF_ITEM(CONF_BELOW_TEMP_ACTION,  "BELOW_TEMP_ACTION", 0x28, 0,              0, 2)    // Action for below temperature: 0-do nothing; 1-startup; 2-shutdown
+CONF_ITEM(CONF_BELOW_TEMP_POINT,   "BELOW_TEMP_POINT",  0x29, 0,              0, 255)  // Set point for below temperature (signed degrees of Celsius)
+CONF_ITEM(CONF_OVER_TEMP_ACTION,   "OVER_TEMP_ACTION",  0x2A, 0,              0, 2)    // Action for over temperature: 0-do nothing; 1-startup; 2-shutdown
+CONF_ITEM(CONF_OVER_TEMP_POINT,    "OVER_TEMP_POINT",   0x2B, 0,              0, 255)  // Set point for over temperature (signed degrees of Celsius)
+
+CONF_ITEM(CONF_DST_OFFSET,         "DST_OFFSET",        0x2C, 0,              0, 255)  // b7=mode; b6~b0: DST offset in minute, default=0(disable DST)
+CONF_ITEM(CONF_DST_BEGIN_MON,      "DST_BEGIN_MON",     0x2D, 0,              0, 255)  // DST begin month in BCD format
+CONF_ITEM(CONF_DST_BEGIN_DAY,      "DST_BEGIN_DAY",     0x2E, 0,              0, 255)  // mode=0: b7~b4=week in BCD, b3~b0=day in BCD; mode=1: b7~b0=date in BCD
+CONF_ITEM(CONF_DST_BEGIN_HOUR,     "DST_BEGIN_HOUR",    0x2F, 0,              0, 255)  // DST begin hour in BCD format
+CONF_ITEM(CONF_DST_BEGIN_MIN,      "DST_BEGIN_MIN",     0x30, 0,              0, 255)  // DST begin minute in BCD format
+CONF_ITEM(CONF_DST_END_MON,        "DST_END_MON",       0x31, 0,              0, 255)  // DST end month in BCD format
+CONF_ITEM(CONF_DST_END_DAY,        "DST_END_DAY",       0x32, 0,              0, 255)  // mode=0: b7~b4=week in BCD, b3~b0=day in BCD; mode=1: b7~b0=date in BCD
+CONF_ITEM(CONF_DST_END_HOUR,       "DST_END_HOUR",      0x33, 0,              0, 255)  // DST end hour in BCD format
+CONF_ITEM(CONF_DST_END_MIN,        "DST_END_MIN",       0x34, 0,              0, 255)  // DST end minute in BCD format
+CONF_ITEM(CONF_DST_APPLIED,        "DST_APPLIED",       0x35, 0,              0, 1)    // Whether DST has been applied
+
+CONF_ITEM(CONF_SYS_CLOCK_MHZ,      "SYS_CLOCK_MHZ",     0x36, 48,             0, 255)  // System clock (in MHz) for RP2350: default=48 (required for USB drive and USB-uart)
+
+CONF_ITEM(CONF_VIN_HOT_STANDBY,    "VIN_HOT_STANDBY",   0x37, 0,              0, 1)    // Keep VIN DC/DC enabled in VUSB-first mode, 0=off, 1=on
+
+CONF_ITEM(CONF_LOG_FORMAT,         "LOG_FORMAT",        0x38, 0,              0, 1)    // Format of log file: 0=text (WittyPi5.log), 1=binary (WittyPi5.wlg)
+CONF_ITEM(CONF_LOG_FILE_SIZE,      "LOG_FILE_SIZE",     0x39, 16,             0, 255)  // Size limit of log file (unit: 64KB) before it is rotated, default=16 (1MB), 0=no limit
+CONF_ITEM(CONF_LOG_LEVEL,          "LOG_LEVEL",         0x3A, 0,              0, 4)    // Minimum level of log messages: 0=DEBUG, 1=INFO, 2=WARN, 3=ERROR, 4=NONE
+
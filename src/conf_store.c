@@ -0,0 +1,345 @@
+#include <stddef.h>
+#include <string.h>
+#include <hardware/flash.h>
+
+#include "conf_store.h"
+#include "conf.h"
+#include "ftl.h"
+#include "util.h"
+
+
+// Binary configuration store, each reserved sector is a bank, the valid one with bigger sequence number wins
+//
+// Bank:
+//   page 0:      image (values, values in configuration file and its date/time)
+//   page 1~15:   journal (8-byte records of changed values appended after the image)
+//
+// A change is appended to the journal of active bank, the image is only written into
+// the other bank when the journal is full, so saving a few changed values costs one
+// or two page programs instead of a sector erase.
+//
+// The records of one saving are followed by a commit record, which is programmed after
+// them and holds their number and CRC. Records without a valid commit are ignored, so
+// a saving interrupted by power loss is either replayed completely or not at all.
+
+#define CONF_STORE_OFFSET       FTL_RESERVED_OFFSET
+#define CONF_STORE_BANKS        FTL_RESERVED_SECTORS
+
+#define CONF_STORE_MAGIC        0x47464357  // "WCFG"
+#define CONF_STORE_VERSION      3
+
+#define CONF_JOURNAL_OFFSET     FLASH_PAGE_SIZE
+#define CONF_JOURNAL_RECORDS    ((FLASH_SECTOR_SIZE - CONF_JOURNAL_OFFSET) / sizeof(conf_record_t))
+
+#define CONF_RECORD_VALUE       0x000   // + key id: value of item
+#define CONF_RECORD_FILE_VALUE  0x100   // + key id: value of item in configuration file
+#define CONF_RECORD_FDATE       0x200   // Date of configuration file
+#define CONF_RECORD_FTIME       0x201   // Time of configuration file
+#define CONF_RECORD_COMMIT      0x300   // + number of records in the batch, value is CRC of those records
+#define CONF_MAX_BATCH          (CONF_MAX_ITEMS * 2 + 2)
+
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t count;
+    uint8_t reserved;
+    uint32_t seq;
+    uint16_t fdate;
+    uint16_t ftime;
+    uint8_t values[CONF_MAX_ITEMS];
+    uint8_t file_values[CONF_MAX_ITEMS];
+    uint32_t crc;
+} conf_image_t;
+
+typedef struct {
+    uint16_t id;
+    uint16_t value;
+    uint16_t id_inv;
+    uint16_t value_inv;
+} conf_record_t;
+
+
+static uint8_t page_buffer[FLASH_PAGE_SIZE];
+
+static uint32_t buffered_page = 0;      // Offset of journal page in page_buffer, 0 for none
+
+static conf_image_t image;              // Content of the store, with journal replayed
+
+static int active_bank = -1;
+
+static int journal_index = 0;
+
+static bool image_needed = true;        // The store doesn't hold the content of image yet
+
+static int batch_start = 0;             // Journal index of the first record in current batch
+
+
+// Offset of the bank in flash
+static inline uint32_t bank_offset(int bank) {
+    return CONF_STORE_OFFSET + bank * FLASH_SECTOR_SIZE;
+}
+
+
+// Check whether the data is fully erased
+static bool is_blank(const uint8_t *data, size_t size) {
+    const uint32_t *d = (const uint32_t *)data;
+    for (size_t i = 0; i < size / 4; i++) {
+        if (d[i] != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Get the image in given bank if it is valid
+static const conf_image_t *get_valid_image(int bank) {
+    const conf_image_t *img = (const conf_image_t *)(XIP_BASE + bank_offset(bank));
+    if (img->magic != CONF_STORE_MAGIC || img->version != CONF_STORE_VERSION || img->count > CONF_MAX_ITEMS) {
+        return NULL;
+    }
+    if (img->crc != crc32((const uint8_t *)img, offsetof(conf_image_t, crc))) {
+        return NULL;
+    }
+    return img;
+}
+
+
+// Apply one journal record to the image
+static void apply_record(uint16_t id, uint16_t value) {
+    if (id >= CONF_RECORD_VALUE && id < CONF_RECORD_VALUE + CONF_MAX_ITEMS) {
+        image.values[id - CONF_RECORD_VALUE] = (uint8_t)value;
+    } else if (id >= CONF_RECORD_FILE_VALUE && id < CONF_RECORD_FILE_VALUE + CONF_MAX_ITEMS) {
+        image.file_values[id - CONF_RECORD_FILE_VALUE] = (uint8_t)value;
+    } else if (id == CONF_RECORD_FDATE) {
+        image.fdate = value;
+    } else if (id == CONF_RECORD_FTIME) {
+        image.ftime = value;
+    }
+}
+
+
+// Check whether the record was completely written
+static inline bool record_valid(const conf_record_t *record) {
+    return (uint16_t)(record->id ^ record->id_inv) == 0xFFFF && (uint16_t)(record->value ^ record->value_inv) == 0xFFFF;
+}
+
+
+// CRC of records that a commit record protects
+static inline uint16_t batch_crc(const conf_record_t *records, int count) {
+    return (uint16_t)crc32((const uint8_t *)records, count * sizeof(conf_record_t));
+}
+
+
+// Apply the batch of records ended by the commit record at given index, return false if it is not complete
+static bool replay_batch(const conf_record_t *records, int commit_index) {
+    const conf_record_t *commit = &records[commit_index];
+    int count = commit->id - CONF_RECORD_COMMIT;
+    if (count > commit_index || commit->value != batch_crc(&records[commit_index - count], count)) {
+        return false;
+    }
+    for (int i = commit_index - count; i < commit_index; i++) {
+        if (!record_valid(&records[i]) || records[i].id >= CONF_RECORD_COMMIT) {
+            return false;
+        }
+    }
+    for (int i = commit_index - count; i < commit_index; i++) {
+        apply_record(records[i].id, records[i].value);
+    }
+    return true;
+}
+
+
+// Replay the committed batches in journal of active bank on top of its image, return false if an incomplete batch is found
+static bool replay_journal(void) {
+    const conf_record_t *records = (const conf_record_t *)(XIP_BASE + bank_offset(active_bank) + CONF_JOURNAL_OFFSET);
+    int committed = 0;
+    int i;
+    for (i = 0; i < CONF_JOURNAL_RECORDS; i++) {
+        const conf_record_t *record = &records[i];
+        if (is_blank((const uint8_t *)record, sizeof(*record))) {
+            break;
+        }
+        if (record_valid(record) && record->id >= CONF_RECORD_COMMIT && record->id <= CONF_RECORD_COMMIT + CONF_MAX_BATCH
+            && replay_batch(records, i)) {
+            committed = i + 1;
+        }
+    }
+    journal_index = i;
+    batch_start = i;
+    // Records after the last commit, or programmed bytes after the first blank record, come from an interrupted saving
+    return committed == i && is_blank((const uint8_t *)&records[i], (CONF_JOURNAL_RECORDS - i) * sizeof(conf_record_t));
+}
+
+
+// Write the image into the other bank, so the current bank is still valid if power is lost
+static bool write_image(void) {
+    int bank = (active_bank + 1) % CONF_STORE_BANKS;
+    uint32_t offset = bank_offset(bank);
+
+    image.magic = CONF_STORE_MAGIC;
+    image.version = CONF_STORE_VERSION;
+    image.reserved = 0;
+    image.seq++;
+    image.crc = crc32((const uint8_t *)&image, offsetof(conf_image_t, crc));
+    memset(page_buffer, 0xFF, FLASH_PAGE_SIZE);
+    memcpy(page_buffer, &image, sizeof(image));
+    buffered_page = 0;
+    ftl_erase_flash(offset, FLASH_SECTOR_SIZE);
+    ftl_program_flash(offset, page_buffer, FLASH_PAGE_SIZE);
+
+    if (memcmp((const uint8_t *)(XIP_BASE + offset), &image, sizeof(image)) != 0) {
+        return false;
+    }
+    active_bank = bank;
+    journal_index = 0;
+    batch_start = 0;
+    image_needed = false;
+    return true;
+}
+
+
+// Program the journal page in buffer
+static void flush_records(void) {
+    if (buffered_page) {
+        ftl_program_flash(bank_offset(active_bank) + buffered_page, page_buffer, FLASH_PAGE_SIZE);
+        buffered_page = 0;
+    }
+}
+
+
+// Put one record into journal, records in the same page are programmed together by flush_records()
+// The change is applied to image in RAM now, but it only survives a reset after commit_records()
+static void append_record(uint16_t id, uint16_t value) {
+    conf_record_t record = {
+        .id = id,
+        .value = value,
+        .id_inv = ~id,
+        .value_inv = ~value,
+    };
+    // Only the bytes of new records get programmed, the rest of page keeps unchanged
+    uint32_t record_offset = CONF_JOURNAL_OFFSET + journal_index * sizeof(conf_record_t);
+    uint32_t page_offset = record_offset & ~(FLASH_PAGE_SIZE - 1);
+    if (page_offset != buffered_page) {
+        flush_records();
+        memset(page_buffer, 0xFF, FLASH_PAGE_SIZE);
+        buffered_page = page_offset;
+    }
+    memcpy(page_buffer + (record_offset - page_offset), &record, sizeof(record));
+    journal_index++;
+    apply_record(id, value);
+}
+
+
+// Program the records of current batch, then a commit record with their number and CRC
+static void commit_records(void) {
+    flush_records();
+    const conf_record_t *records = (const conf_record_t *)(XIP_BASE + bank_offset(active_bank) + CONF_JOURNAL_OFFSET);
+    int count = journal_index - batch_start;
+    append_record(CONF_RECORD_COMMIT + count, batch_crc(&records[batch_start], count));
+    flush_records();
+    batch_start = journal_index;
+}
+
+
+/**
+ * Load configuration values from the binary store in flash
+ * 
+ * @param values Buffer for values, indexed by key id
+ * @param file_values Buffer for values in configuration file when it was synchronized, indexed by key id
+ * @param count Number of values expected
+ * @param fdate Pointer to receive the date of configuration file when it was synchronized
+ * @param ftime Pointer to receive the time of configuration file when it was synchronized
+ * @return true if a valid image with expected number of values is loaded, false otherwise
+ */
+bool conf_store_load(uint8_t *values, uint8_t *file_values, uint8_t count, uint16_t *fdate, uint16_t *ftime) {
+    const conf_image_t *latest = NULL;
+    active_bank = -1;
+    image_needed = true;
+    for (int i = 0; i < CONF_STORE_BANKS; i++) {
+        const conf_image_t *img = get_valid_image(i);
+        if (img && (!latest || (int32_t)(img->seq - latest->seq) > 0)) {
+            latest = img;
+            active_bank = i;
+        }
+    }
+    if (!latest) {
+        return false;
+    }
+    memcpy(&image, latest, sizeof(image));
+    // After an interrupted saving the journal may have partly programmed bytes, write a new image next time
+    bool journal_clean = replay_journal();
+    if (image.count != count) {
+        return false;   // Items have been changed by firmware update
+    }
+    image_needed = !journal_clean;
+    memcpy(values, image.values, count);
+    memcpy(file_values, image.file_values, count);
+    *fdate = image.fdate;
+    *ftime = image.ftime;
+    return true;
+}
+
+
+/**
+ * Save configuration values into the binary store in flash
+ * 
+ * Only the changes since last saving are appended to the journal and committed together,
+ * the whole image is written into the other bank when the journal is full
+ * 
+ * @param values Values indexed by key id
+ * @param file_values Values in configuration file when it was synchronized, indexed by key id
+ * @param count Number of values
+ * @param fdate The date of configuration file when it was synchronized
+ * @param ftime The time of configuration file when it was synchronized
+ * @return Number of changes saved, 0 if nothing is changed, -1 if failed
+ */
+int conf_store_save(const uint8_t *values, const uint8_t *file_values, uint8_t count, uint16_t fdate, uint16_t ftime) {
+    if (count > CONF_MAX_ITEMS) {
+        return -1;
+    }
+    int changes = (count != image.count) + (fdate != image.fdate) + (ftime != image.ftime);
+    for (int i = 0; i < count; i++) {
+        changes += (values[i] != image.values[i]) + (file_values[i] != image.file_values[i]);
+    }
+    if (image.count != count) {
+        image_needed = true;
+    }
+    if (changes == 0 && !image_needed) {
+        return 0;
+    }
+
+    if (image_needed || journal_index + changes + 1 > CONF_JOURNAL_RECORDS) {
+        image.count = count;
+        memcpy(image.values, values, count);
+        memcpy(image.file_values, file_values, count);
+        image.fdate = fdate;
+        image.ftime = ftime;
+        if (!write_image()) {
+            image_needed = true;
+            return -1;
+        }
+        return changes;
+    }
+
+    // File date/time goes last, a file saved before power loss is then seen as changed on disk
+    for (int i = 0; i < count; i++) {
+        if (values[i] != image.values[i]) {
+            append_record(CONF_RECORD_VALUE + i, values[i]);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (file_values[i] != image.file_values[i]) {
+            append_record(CONF_RECORD_FILE_VALUE + i, file_values[i]);
+        }
+    }
+    if (fdate != image.fdate) {
+        append_record(CONF_RECORD_FDATE, fdate);
+    }
+    if (ftime != image.ftime) {
+        append_record(CONF_RECORD_FTIME, ftime);
+    }
+    commit_records();
+    return changes;
+}
@@ -0,0 +1,37 @@
+#ifndef _CONF_STORE_H_
+#define _CONF_STORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**
+ * Load configuration values from the binary store in flash
+ * 
+ * @param values Buffer for values, indexed by key id
+ * @param file_values Buffer for values in configuration file when it was synchronized, indexed by key id
+ * @param count Number of values expected
+ * @param fdate Pointer to receive the date of configuration file when it was synchronized
+ * @param ftime Pointer to receive the time of configuration file when it was synchronized
+ * @return true if a valid image with expected number of values is loaded, false otherwise
+ */
+bool conf_store_load(uint8_t *values, uint8_t *file_values, uint8_t count, uint16_t *fdate, uint16_t *ftime);
+
+
+/**
+ * Save configuration values into the binary store in flash
+ * 
+ * Only the changes since last saving are appended to the journal and committed together,
+ * the whole image is written into the other bank when the journal is full
+ * 
+ * @param values Values indexed by key id
+ * @param file_values Values in configuration file when it was synchronized, indexed by key id
+ * @param count Number of values
+ * @param fdate The date of configuration file when it was synchronized
+ * @param ftime The time of configuration file when it was synchronized
+ * @return Number of changes saved, 0 if nothing is changed, -1 if failed
+ */
+int conf_store_save(const uint8_t *values, const uint8_t *file_values, uint8_t count, uint16_t fdate, uint16_t ftime);
+
+
+#endif
@@ -10,6 +10,9 @@
 #include "usb_msc_device.h"
 
 
+#define LOG_MODULE          "disk"
+
+
 typedef struct {
   uint8_t DIR_Name[11];
   uint8_t DIR_Attr;
@@ -32,6 +35,8 @@ FATFS filesystem;
 
 bool fatfs_mounted = false;
 
+static uint32_t host_write_count = 0;
+
 
 DSTATUS disk_status(BYTE drv) {
     return Stat;
@@ -70,6 +75,10 @@ DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff) {
         *(WORD*)buff = FAT_BLOCK_SIZE;
         return RES_OK;
     }
+    if (ctrl == CTRL_SYNC) {
+        flash_fatfs_flush(false);
+        return RES_OK;
+    }
     return RES_OK;
 }
 
@@ -142,6 +151,7 @@ bool mount_fatfs(void) {
  */
 bool unmount_fatfs(void) {
     if (fatfs_mounted) {
+        close_log_file();
         if (f_unmount("/") == FR_OK) {
             fatfs_mounted = false;
             return true;
@@ -154,6 +164,37 @@ bool unmount_fatfs(void) {
 }
 
 
+/**
+ * Mark FatFs as outdated after the USB host changed the disk, it will be
+ * mounted again the next time it is used
+ */
+void invalidate_fatfs(void) {
+    // FatFs checks disk status before using the volume, and mounts it again if not initialized
+    Stat = STA_NOINIT;
+    host_write_count++;
+}
+
+
+/**
+ * Get the number of times the USB host changed the disk since power on
+ * 
+ * @return The number of disk changes made by USB host
+ */
+uint32_t get_fatfs_host_write_count(void) {
+    return host_write_count;
+}
+
+
+/**
+ * Check if FatFs has changes in its window that are not written to disk yet
+ * 
+ * @return true if the window is dirty, false otherwise
+ */
+bool is_fatfs_window_dirty(void) {
+    return fatfs_mounted && filesystem.wflag;
+}
+
+
 /**
  * Try to create a directory
  * 
@@ -182,15 +223,15 @@ bool check_and_create_directory(const char *path) {
 void create_default_dirs(void) {
     
 	if (!check_and_create_directory("/log")) {
-        debug_log("Error creating log directory\n");
+        log_error("Error creating log directory\n");
     }
     
 	if (!check_and_create_directory("/conf")) {
-        debug_log("Error creating conf directory\n");
+        log_error("Error creating conf directory\n");
     }
 
 	if (!check_and_create_directory("/schedule")) {
-        debug_log("Error creating schedule directory\n");
+        log_error("Error creating schedule directory\n");
     }
 }
 
@@ -220,6 +261,7 @@ bool file_delete(const char *path) {
     if (path == NULL) {
         return false;
     }
+    close_log_file();   // In case it is the log file
     fr = f_unlink(path);
     if (fr == FR_OK) {
         return true;
@@ -245,13 +287,14 @@ bool file_copy(const char *dest, const char *src) {
 
     fr = f_open(&fsrc, src, FA_READ);
     if (fr != FR_OK) {
-        debug_log("Error: Cannot open source file (%s), error code: %d\n", src, fr);
+        log_error("Cannot open source file (%s), error code: %d\n", src, fr);
         return false;
     }
 
+    close_log_file();   // In case the destination is the log file
     fr = f_open(&fdst, dest, FA_WRITE | FA_CREATE_ALWAYS);
     if (fr != FR_OK) {
-        debug_log("Error: Cannot create destination file (%s), error code: %d\n", dest, fr);
+        log_error("Cannot create destination file (%s), error code: %d\n", dest, fr);
         f_close(&fsrc);
         return false;
     }
@@ -262,7 +305,7 @@ bool file_copy(const char *dest, const char *src) {
         
         fr = f_write(&fdst, buffer, br, &bw);
         if (fr != FR_OK || bw < br) {
-            debug_log("Error: Write error, error code: %d\n", fr);
+            log_error("Write error, error code: %d\n", fr);
             result = false;
             break;
         }
@@ -271,7 +314,7 @@ bool file_copy(const char *dest, const char *src) {
     f_close(&fsrc);
     f_close(&fdst);
     if (fr != FR_OK && fr != FR_INT_ERR && result) {
-        debug_log("Error: Read error, error code: %d\n", fr);
+        log_error("Read error, error code: %d\n", fr);
         result = false;
     }
     return result;
@@ -294,19 +337,19 @@ int load_file(const char *path, char *buffer, int buf_size) {
 
     fr = f_open(&file, path, FA_READ);
     if (fr != FR_OK) {
-        debug_log("Error: Cannot open file (%s), error code: %d\n", path, fr);
+        log_error("Cannot open file (%s), error code: %d\n", path, fr);
         return -1;
     }
 
     int file_size = f_size(&file);
     if (file_size > buf_size) {
-        debug_log("Error: The size of file (%s) exceeds buffer size: %d\n", path, file_size);
+        log_error("The size of file (%s) exceeds buffer size: %d\n", path, file_size);
         return -1;
     }
 
     fr = f_read(&file, buffer, file_size, &bytes_read);
     if (fr != FR_OK) {
-        debug_log("Error: Failed to read file (%s), error code: %d\n", path, fr);
+        log_error("Failed to read file (%s), error code: %d\n", path, fr);
         f_close(&file);
         return -1;
     }
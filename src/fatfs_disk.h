@@ -28,6 +28,29 @@ bool mount_fatfs(void);
 bool unmount_fatfs(void);
 
 
+/**
+ * Mark FatFs as outdated after the USB host changed the disk, it will be
+ * mounted again the next time it is used
+ */
+void invalidate_fatfs(void);
+
+
+/**
+ * Get the number of times the USB host changed the disk since power on
+ * 
+ * @return The number of disk changes made by USB host
+ */
+uint32_t get_fatfs_host_write_count(void);
+
+
+/**
+ * Check if FatFs has changes in its window that are not written to disk yet
+ * 
+ * @return true if the window is dirty, false otherwise
+ */
+bool is_fatfs_window_dirty(void);
+
+
 /**
  * Try to create a directory
  * 
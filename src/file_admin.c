@@ -10,6 +10,9 @@
 #include "script.h"
 #include "log.h"
 
+
+#define LOG_MODULE          "admin"
+
 #define DIRECTORY_SCHEDULE 4
 
 // Internal download session state for chunked transfers
@@ -186,7 +189,7 @@ uint8_t file_admin_load_chunk(void) {
 
         // End session
         download_state.active = false;
-        debug_log("Download complete\n");
+        log_info("Download complete\n");
         return ADMIN_STATUS_OK;
     }
 
@@ -239,7 +242,7 @@ uint8_t file_admin_load_chunk(void) {
     // Advance position
     download_state.offset += bytes_read;
 
-    debug_log("Chunk: %lu bytes (offset now %lu/%lu)\n",
+    log_debug("Chunk: %lu bytes (offset now %lu/%lu)\n",
               (unsigned long)bytes_read, (unsigned long)download_state.offset,
               (unsigned long)download_state.file_size);
 
@@ -250,12 +253,12 @@ uint8_t file_admin_load_chunk(void) {
 uint8_t file_admin_upload(uint8_t dir) {
     // Only /schedule allowed for uploads
     if (dir != DIRECTORY_SCHEDULE) {
-        debug_log("Upload rejected: only /schedule allowed\n");
+        log_warn("Upload rejected: only /schedule allowed\n");
         return ADMIN_STATUS_INVALID_DIRECTORY;
     }
 
     if (i2c_is_upload_buffer_overflowed()) {
-        debug_log("Upload rejected: packet too large\n");
+        log_warn("Upload rejected: packet too large\n");
         return ADMIN_STATUS_FILE_TOO_LARGE;
     }
 
@@ -263,56 +266,56 @@ uint8_t file_admin_upload(uint8_t dir) {
     const uint8_t *upload_buffer = i2c_get_upload_buffer();
     size_t buf_len = i2c_get_upload_buffer_len();
     if (!upload_buffer || buf_len == 0) {
-        debug_log("Upload rejected: buffer is invalid\n");
+        log_warn("Upload rejected: buffer is invalid\n");
         return ADMIN_STATUS_INVALID_PACKET;
     }
 
     // Parse packet: <filename|content|HH>
     int start = find_byte_bounded(upload_buffer, buf_len, (uint8_t)PACKET_BEGIN, 0);
     if (start < 0) {
-        debug_log("Upload rejected: missing PACKET_BEGIN\n");
+        log_warn("Upload rejected: missing PACKET_BEGIN\n");
         return ADMIN_STATUS_INVALID_PACKET;
     }
     int end = find_byte_bounded(upload_buffer, buf_len, (uint8_t)PACKET_END, (size_t)start + 1);
     if (end < 0 || end <= start + 1) {
-        debug_log("Upload rejected: missing PACKET_END\n");
+        log_warn("Upload rejected: missing PACKET_END\n");
         return ADMIN_STATUS_INVALID_PACKET;
     }
     int delim1 = find_byte_bounded(upload_buffer, (size_t)end, (uint8_t)PACKET_DELIMITER, (size_t)start + 1);
     int delim2 = find_byte_bounded(upload_buffer, (size_t)end, (uint8_t)PACKET_DELIMITER, (size_t)delim1 + 1);
     if (delim1 < 0 || delim2 < 0 || delim1 <= start || delim2 <= delim1) {
-        debug_log("Upload rejected: PACKET_DELIMITER is missing or misplaced\n");
+        log_warn("Upload rejected: PACKET_DELIMITER is missing or misplaced\n");
         return ADMIN_STATUS_INVALID_PACKET;
     }
 
     // Validate CRC: packet must end with "|HH>" and CRC-8 is calculated over "<...|" (including the last '|')
     if (end != delim2 + 3) {
-        debug_log("Upload rejected: CRC field length is invalid\n");
+        log_warn("Upload rejected: CRC field length is invalid\n");
         return ADMIN_STATUS_INVALID_PACKET;
     }
     uint8_t crc_rx = 0;
     if (!parse_hex_byte_2chars(&upload_buffer[delim2 + 1], &crc_rx)) {
-        debug_log("Upload rejected: CRC field is not valid hex\n");
+        log_warn("Upload rejected: CRC field is not valid hex\n");
         return ADMIN_STATUS_INVALID_PACKET;
     }
     size_t crc_len = (size_t)(delim2 - start + 1);
     uint8_t crc_calc = i2c_calculate_crc8(&upload_buffer[start], crc_len);
     if (crc_calc != crc_rx) {
-        debug_log("Upload rejected: CRC mismatch (calc=%02X rx=%02X)\n", crc_calc, crc_rx);
+        log_warn("Upload rejected: CRC mismatch (calc=%02X rx=%02X)\n", crc_calc, crc_rx);
         return ADMIN_STATUS_INVALID_PACKET;
     }
 
     // Extract filename
     int name_len = delim1 - start - 1;
     if (name_len <= 0 || name_len >= ADMIN_MAX_FILENAME_LEN) {
-        debug_log("Upload rejected: filename length is %d\n", name_len);
+        log_warn("Upload rejected: filename length is %d\n", name_len);
         return ADMIN_STATUS_INVALID_PACKET;
     }
     char filename[ADMIN_MAX_FILENAME_LEN];
     memcpy(filename, &upload_buffer[start + 1], name_len);
     filename[name_len] = '\0';
     if (!is_allowed_schedule_filename(filename)) {
-        debug_log("Upload rejected: unsupported filename extension: %s\n", filename);
+        log_warn("Upload rejected: unsupported filename extension: %s\n", filename);
         return ADMIN_STATUS_INVALID_PACKET;
     }
 
@@ -323,13 +326,13 @@ uint8_t file_admin_upload(uint8_t dir) {
         return ADMIN_STATUS_INVALID_PACKET;
     }
     if (content_len > ADMIN_MAX_FILE_CONTENT) {
-        debug_log("Upload rejected: content too large (%d > %d)\n", content_len, ADMIN_MAX_FILE_CONTENT);
+        log_warn("Upload rejected: content too large (%d > %d)\n", content_len, ADMIN_MAX_FILE_CONTENT);
         return ADMIN_STATUS_FILE_TOO_LARGE;
     }
 
     // Reject content with protocol delimiters
     if (content_len > 0 && content_has_delimiters(content, content_len)) {
-        debug_log("Upload rejected: content contains reserved characters\n");
+        log_warn("Upload rejected: content contains reserved characters\n");
         return ADMIN_STATUS_INVALID_PACKET;
     }
 
@@ -344,6 +347,7 @@ uint8_t file_admin_upload(uint8_t dir) {
 
     // Write file
     FIL file;
+    close_log_file();   // In case it is the log file
     if (f_open(&file, filepath, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
         return ADMIN_STATUS_IO_ERROR;
     }
@@ -355,7 +359,7 @@ uint8_t file_admin_upload(uint8_t dir) {
     f_close(&file);
 
     if (bw == (UINT)content_len) {
-        debug_log("Uploaded %d bytes to %s\n", content_len, filepath);
+        log_info("Uploaded %d bytes to %s\n", content_len, filepath);
         return ADMIN_STATUS_OK;
     }
     return ADMIN_STATUS_IO_ERROR;
@@ -397,7 +401,7 @@ uint8_t file_admin_download(uint8_t dir) {
     download_state.offset = 0;
     download_state.active = true;
 
-    debug_log("Download started: %s (%lu bytes)\n", filepath, (unsigned long)fno.fsize);
+    log_info("Download started: %s (%lu bytes)\n", filepath, (unsigned long)fno.fsize);
 
     // Load first chunk (or EOF packet for empty files)
     return file_admin_load_chunk();
@@ -407,7 +411,7 @@ uint8_t file_admin_download(uint8_t dir) {
 uint8_t file_admin_delete(uint8_t dir) {
     // Only /schedule allowed for delete
     if (dir != DIRECTORY_SCHEDULE) {
-        debug_log("Delete rejected: only /schedule allowed\n");
+        log_warn("Delete rejected: only /schedule allowed\n");
         return ADMIN_STATUS_INVALID_DIRECTORY;
     }
 
@@ -420,13 +424,13 @@ uint8_t file_admin_delete(uint8_t dir) {
         return ADMIN_STATUS_INVALID_PACKET;
     }
     if (!is_allowed_schedule_filename(filename)) {
-        debug_log("Delete rejected: unsupported filename extension: %s\n", filename);
+        log_warn("Delete rejected: unsupported filename extension: %s\n", filename);
         return ADMIN_STATUS_INVALID_PACKET;
     }
 
     // Prevent deletion of active schedule files (schedule.wpi, schedule.act, schedule.skd)
     if (is_script_in_use() && is_protected_schedule_file(filename)) {
-        debug_log("Delete rejected: cannot delete active script\n");
+        log_warn("Delete rejected: cannot delete active script\n");
         return ADMIN_STATUS_CANNOT_DELETE_ACTIVE;
     }
 
@@ -446,7 +450,7 @@ uint8_t file_admin_delete(uint8_t dir) {
 
     // Delete file
     if (file_delete(filepath)) {
-        debug_log("Deleted %s\n", filepath);
+        log_info("Deleted %s\n", filepath);
         return ADMIN_STATUS_OK;
     }
     return ADMIN_STATUS_IO_ERROR;
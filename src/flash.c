@@ -1,6 +1,26 @@
 #include "flash.h"
 #include "log.h"
 #include "led.h"
+#include "ftl.h"
+#include "i2c.h"
+#include "fatfs_disk.h"
+#include "usb_msc_device.h"
+
+
+#define LOG_MODULE          "flash"
+
+
+#define FLASH_CACHE_SECTORS         6         // Number of 4k sectors cached in RAM (data, 2 FATs and directory of a log flush)
+#define FLASH_CACHE_IDLE_FLUSH_US   1000000   // Flush the cache after 1 second without writing
+
+#define FLASH_GC_I2C_IDLE_US        50000     // Only erase in background if I2C is idle for 50ms
+#define FLASH_GC_URGENT_I2C_IDLE_US 2000      // Idle time that is enough when erased sectors are running out
+
+#define FLASH_PRE_ERASE_SLICE       16        // Number of clusters checked for pre-erasing in one slice
+#define FLASH_PRE_ERASE_HOST_IDLE_US 2000000  // Only pre-erase if USB host has not written for 2 seconds
+
+#define FLASH_BLOCKS_PER_SECTOR     (FLASH_SECTOR_SIZE / FAT_BLOCK_SIZE)
+#define FLASH_ALL_BLOCKS_WRITTEN    ((1 << FLASH_BLOCKS_PER_SECTOR) - 1)
 
 
 uint8_t boot_sector[FAT_BLOCK_SIZE] = {
@@ -66,6 +86,364 @@ uint8_t root_dir_sector[FAT_BLOCK_SIZE] = {
 };
 
 
+typedef struct {
+    int sector;         // Flash sector index in FAT region, -1 if the entry is not used
+    bool dirty;         // Whether the data is newer than flash
+    bool deferred;      // Whether writing is waiting for an erased sector
+    uint8_t written;    // Bit mask of blocks written since last flush
+    uint32_t last_use;  // For choosing the least recently used entry
+    uint8_t data[FLASH_SECTOR_SIZE];
+} flash_cache_entry_t;
+
+static flash_cache_entry_t cache[FLASH_CACHE_SECTORS] = {
+    [0 ... FLASH_CACHE_SECTORS - 1] = {.sector = -1}
+};
+
+static uint32_t cache_use_counter = 0;
+
+static absolute_time_t last_cache_write_time;
+
+static flash_stats_t stats = {0};
+
+typedef struct {
+    bool valid;             // Whether the volume layout allows pre-erasing
+    int fat_block;          // First block of FAT
+    int data_block;         // First block of cluster 2
+    int cluster_blocks;     // Number of blocks per cluster
+    int cluster_count;      // Number of clusters + 2
+    bool fat16;             // FAT16 instead of FAT12
+} fat_layout_t;
+
+static fat_layout_t fat_layout;
+
+static int pre_erase_cursor = 2;
+
+static uint32_t pre_erase_ready = 0;
+
+static uint8_t fat_buffer[FAT_BLOCK_SIZE * 2];
+
+static int fat_buffer_block = -1;
+
+static uint8_t host_written[(FTL_LOGICAL_SECTORS + 7) / 8];    // Sectors written by USB host, not seen allocated in FAT yet
+
+static uint32_t host_writes = 0;
+
+static uint32_t pre_erase_host_writes = 0;  // Value of host_writes when current scan started
+
+static absolute_time_t last_host_write_time;
+
+
+// Keep the longest time that interrupts were disabled for flash operation
+static void record_irq_off_time(uint64_t start) {
+    uint32_t duration = (uint32_t)(time_us_64() - start);
+    if (duration > stats.max_irq_off_us) {
+        stats.max_irq_off_us = duration;
+    }
+}
+
+
+// Check whether the page can be programmed without erasing (only 1->0 bit transitions)
+static bool page_programmable(const uint8_t *old_data, const uint8_t *new_data) {
+    const uint32_t *o = (const uint32_t *)old_data;
+    const uint32_t *n = (const uint32_t *)new_data;
+    for (int i = 0; i < FLASH_PAGE_SIZE / 4; i++) {
+        if ((o[i] & n[i]) != n[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Check whether the page is fully erased
+static bool page_blank(const uint8_t *data) {
+    const uint32_t *d = (const uint32_t *)data;
+    for (int i = 0; i < FLASH_PAGE_SIZE / 4; i++) {
+        if (d[i] != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Check whether the sector in FAT region is fully erased
+static bool sector_blank(int sector) {
+    const uint8_t *flash_data = (const uint8_t *)(XIP_BASE + ftl_get_sector_offset(sector));
+    for (int i = 0; i < FLASH_SECTOR_SIZE; i += FLASH_PAGE_SIZE) {
+        if (!page_blank(flash_data + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Write a whole flash sector in FAT region, relocate it only when erasing is necessary
+// Return false if it waits for an erased sector, a forced write erases in place as the last resort
+static bool program_sector(int sector, const uint8_t *data, bool force) {
+
+    uint32_t sector_addr = ftl_get_sector_offset(sector);
+    const uint8_t *flash_data = (const uint8_t *)(XIP_BASE + sector_addr);
+
+    // Compare with current flash content page by page
+    bool changed[FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE];
+    bool need_erase = false;
+    bool any_change = false;
+    for (int i = 0; i < FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE; i++) {
+        uint32_t page_offset = i * FLASH_PAGE_SIZE;
+        changed[i] = (memcmp(flash_data + page_offset, data + page_offset, FLASH_PAGE_SIZE) != 0);
+        if (changed[i]) {
+            any_change = true;
+            if (!page_programmable(flash_data + page_offset, data + page_offset)) {
+                need_erase = true;
+            }
+        }
+    }
+    if (!any_change) {
+        stats.sectors_skipped++;
+        stats.erases_avoided++;
+        return true;
+    }
+
+    // Keep it in cache until an erased sector is prepared in background, instead of erasing now
+    if (need_erase && !force && !ftl_can_write_sector(false)) {
+        stats.writes_deferred++;
+        return false;
+    }
+
+    control_led(true, 0);
+
+    // Write into a spare sector, old sector will be erased in background
+    if (need_erase && ftl_write_sector(sector, data, force)) {
+        stats.sectors_relocated++;
+        for (int i = 0; i < FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE; i++) {
+            if (!page_blank(data + i * FLASH_PAGE_SIZE)) {
+                stats.pages_programmed++;
+            }
+        }
+        control_led(false, 0);
+        return true;
+    }
+
+    // Temporarily disable USB to avoid interference
+    stdio_set_driver_enabled(&stdio_usb, false);
+
+    // Interrupts are disabled for each erase or page program only, so IRQ handlers can run in between
+    if (need_erase) {
+        uint32_t ints = save_and_disable_interrupts();
+        uint64_t start = time_us_64();
+        flash_range_erase(sector_addr, FLASH_SECTOR_SIZE);
+        record_irq_off_time(start);
+        restore_interrupts(ints);
+        stats.erases++;
+    } else {
+        stats.erases_avoided++;
+    }
+    for (int i = 0; i < FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE; i++) {
+        uint32_t page_offset = i * FLASH_PAGE_SIZE;
+        // After erasing, every page that is not blank must be programmed again
+        bool program = need_erase ? !page_blank(data + page_offset) : changed[i];
+        if (program) {
+            uint32_t ints = save_and_disable_interrupts();
+            uint64_t start = time_us_64();
+            flash_range_program(sector_addr + page_offset, data + page_offset, FLASH_PAGE_SIZE);
+            record_irq_off_time(start);
+            restore_interrupts(ints);
+            stats.pages_programmed++;
+        }
+    }
+
+    // Restore USB
+    stdio_set_driver_enabled(&stdio_usb, true);
+
+    control_led(false, 0);
+    return true;
+}
+
+
+// Write the cached sector into flash if it is dirty, it stays dirty if it has to wait for an erased sector
+static void cache_flush_entry(flash_cache_entry_t *entry, bool force) {
+    entry->written = 0;
+    if (entry->sector < 0 || !entry->dirty) {
+        return;
+    }
+    if (entry->deferred && !force && !ftl_can_write_sector(false)) {
+        return;     // No need to compare with flash again
+    }
+    entry->deferred = !program_sector(entry->sector, entry->data, force);
+    entry->dirty = entry->deferred;
+}
+
+
+// Find the cache entry for given sector, NULL if not cached
+static flash_cache_entry_t *cache_find(int sector) {
+    for (int i = 0; i < FLASH_CACHE_SECTORS; i++) {
+        if (cache[i].sector == sector) {
+            cache[i].last_use = ++cache_use_counter;
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+
+// Load given sector into the least recently used clean entry, or the least recently used
+// one (which will be flushed first) if all are dirty
+// Reading flash can be skipped if the whole sector will be overwritten
+static flash_cache_entry_t *cache_load(int sector, bool read_flash) {
+    flash_cache_entry_t *entry = NULL;
+    for (int i = 0; i < FLASH_CACHE_SECTORS; i++) {
+        if (!cache[i].dirty && (!entry || cache[i].last_use < entry->last_use)) {
+            entry = &cache[i];
+        }
+    }
+    if (!entry) {
+        entry = &cache[0];
+        for (int i = 1; i < FLASH_CACHE_SECTORS; i++) {
+            if (cache[i].last_use < entry->last_use) {
+                entry = &cache[i];
+            }
+        }
+        cache_flush_entry(entry, true);     // The entry is needed now, it cannot wait
+    }
+
+    if (read_flash) {
+        memcpy(entry->data, (uint8_t *)(XIP_BASE + ftl_get_sector_offset(sector)), FLASH_SECTOR_SIZE);
+    }
+    entry->sector = sector;
+    entry->dirty = false;
+    entry->deferred = false;
+    entry->written = 0;
+    entry->last_use = ++cache_use_counter;
+    return entry;
+}
+
+
+// Load the volume layout from boot sector, pre-erasing is only possible if clusters are aligned to flash sectors
+static void load_fat_layout(void) {
+    uint8_t bs[FAT_BLOCK_SIZE];
+    flash_fatfs_read(0, bs, FAT_BLOCK_SIZE);
+
+    uint16_t bytes_per_sector = bs[11] | (bs[12] << 8);
+    uint8_t sectors_per_cluster = bs[13];
+    uint16_t reserved = bs[14] | (bs[15] << 8);
+    uint8_t fat_num = bs[16];
+    uint16_t root_entries = bs[17] | (bs[18] << 8);
+    uint32_t total = bs[19] | (bs[20] << 8);
+    if (total == 0) {
+        total = bs[32] | (bs[33] << 8) | (bs[34] << 16) | ((uint32_t)bs[35] << 24);
+    }
+    uint16_t fat_size = bs[22] | (bs[23] << 8);
+
+    fat_layout.valid = false;
+    if (bs[510] != 0x55 || bs[511] != 0xAA || bytes_per_sector != FAT_BLOCK_SIZE || sectors_per_cluster == 0 || fat_size == 0) {
+        return;
+    }
+    fat_layout.fat_block = reserved;
+    fat_layout.data_block = reserved + fat_num * fat_size + root_entries * 32 / FAT_BLOCK_SIZE;
+    fat_layout.cluster_blocks = sectors_per_cluster;
+    if (total > FAT_BLOCK_NUM || total <= fat_layout.data_block) {
+        return;
+    }
+    fat_layout.cluster_count = (total - fat_layout.data_block) / sectors_per_cluster + 2;
+    fat_layout.fat16 = (fat_layout.cluster_count - 2 >= 4085);
+    if (fat_layout.cluster_count - 2 >= 65525) {
+        return; // FAT32 is not expected on this disk
+    }
+    fat_layout.valid = (fat_layout.data_block % FLASH_BLOCKS_PER_SECTOR == 0)
+                    && (sectors_per_cluster % FLASH_BLOCKS_PER_SECTOR == 0);
+}
+
+
+// Read the FAT entry of given cluster
+static int read_fat_entry(int cluster) {
+    int offset = fat_layout.fat16 ? cluster * 2 : cluster + cluster / 2;
+    int block = fat_layout.fat_block + offset / FAT_BLOCK_SIZE;
+    if (block != fat_buffer_block) {
+        flash_fatfs_read(block, fat_buffer, sizeof(fat_buffer));   // Entry may cross block boundary
+        fat_buffer_block = block;
+    }
+    offset %= FAT_BLOCK_SIZE;
+    uint16_t value = fat_buffer[offset] | (fat_buffer[offset + 1] << 8);
+    if (fat_layout.fat16) {
+        return value;
+    }
+    return (cluster & 1) ? (value >> 4) : (value & 0xFFF);
+}
+
+
+// Check whether the file system is being changed, by firmware (FAT in FatFs window) or by USB host
+static bool fat_may_change(void) {
+    return is_fatfs_window_dirty() || absolute_time_diff_us(last_host_write_time, get_absolute_time()) < FLASH_PRE_ERASE_HOST_IDLE_US;
+}
+
+
+// Allow pre-erasing the sectors of given cluster again, once it is seen allocated in FAT
+static void clear_host_written(int cluster) {
+    int first_sector = (fat_layout.data_block + (cluster - 2) * fat_layout.cluster_blocks) / FLASH_BLOCKS_PER_SECTOR;
+    int sectors = fat_layout.cluster_blocks / FLASH_BLOCKS_PER_SECTOR;
+    for (int sector = first_sector; sector < first_sector + sectors; sector++) {
+        host_written[sector / 8] &= ~(1 << (sector % 8));
+    }
+}
+
+
+// Check several clusters from the cursor, erase the first free one that is not erased yet
+// A free cluster written by USB host is skipped, until it is seen allocated in FAT (host may write data before FAT)
+static bool pre_erase_slice(void) {
+    if (pre_erase_cursor == 2) {
+        load_fat_layout();
+        pre_erase_ready = 0;
+        pre_erase_host_writes = host_writes;
+    }
+    if (fat_may_change() || host_writes != pre_erase_host_writes) {
+        pre_erase_cursor = 2;   // Start over with fresh layout later
+        return false;
+    }
+    if (!fat_layout.valid) {
+        return false;
+    }
+
+    fat_buffer_block = -1;  // FAT may have been changed since last slice
+    for (int n = 0; n < FLASH_PRE_ERASE_SLICE; n++) {
+        int cluster = pre_erase_cursor;
+        if (cluster >= fat_layout.cluster_count) {
+            // Full scan is done, start over in next slice
+            stats.free_sectors_erased = pre_erase_ready;
+            pre_erase_cursor = 2;
+            return false;
+        }
+        pre_erase_cursor++;
+        if (read_fat_entry(cluster) != 0) {
+            clear_host_written(cluster);
+            continue;
+        }
+        int first_sector = (fat_layout.data_block + (cluster - 2) * fat_layout.cluster_blocks) / FLASH_BLOCKS_PER_SECTOR;
+        int sectors = fat_layout.cluster_blocks / FLASH_BLOCKS_PER_SECTOR;
+        bool erased = false;
+        for (int sector = first_sector; sector < first_sector + sectors; sector++) {
+            if (cache_find(sector) || (host_written[sector / 8] & (1 << (sector % 8)))) {
+                continue;
+            }
+            if (!sector_blank(sector)) {
+                ftl_erase_sector(sector);
+                stats.sectors_pre_erased++;
+                if (is_usb_msc_device_mounted()) {
+                    stats.sectors_pre_erased_mounted++;
+                }
+                erased = true;
+            }
+            pre_erase_ready++;
+        }
+        if (erased) {
+            return true;    // One slice erases one cluster at most
+        }
+    }
+    return false;
+}
+
+
 /**
  * Write 4k sector into flash
  * 
@@ -119,6 +497,19 @@ int flash_write_4k_sector(int offset, uint8_t *b0, uint8_t *b1, uint8_t *b2, uin
  * Initialize FatFS for flash
  */
 void flash_fatfs_init(void) {
+
+    // Discard cached sectors, they belong to the old file system
+    for (int i = 0; i < FLASH_CACHE_SECTORS; i++) {
+        cache[i].sector = -1;
+        cache[i].dirty = false;
+        cache[i].deferred = false;
+    }
+
+    // Map all sectors back to their original location
+    ftl_format();
+    pre_erase_cursor = 2;
+    memset(host_written, 0, sizeof(host_written));
+
     uint32_t ints = save_and_disable_interrupts();
 
     int offset = 0;
@@ -152,8 +543,28 @@ void flash_fatfs_init(void) {
  * @return true if read succeed
  */
 bool flash_fatfs_read(int block, uint8_t *buffer, size_t buffer_size) {
-    const uint8_t *data = (uint8_t *)(XIP_BASE + FLASH_FAT_OFFSET + FAT_BLOCK_SIZE * block);
-    memcpy(buffer, data, buffer_size);
+    uint32_t addr = block * FAT_BLOCK_SIZE;
+    uint32_t end_addr = addr + buffer_size;
+
+    while (addr < end_addr) {
+        int sector = addr / FLASH_SECTOR_SIZE;
+        uint32_t sector_offset = addr % FLASH_SECTOR_SIZE;
+        uint32_t size = FLASH_SECTOR_SIZE - sector_offset;
+        if (size > end_addr - addr) {
+            size = end_addr - addr;
+        }
+
+        // Cached sector may be newer than the data in flash
+        flash_cache_entry_t *entry = cache_find(sector);
+        if (entry) {
+            memcpy(buffer, entry->data + sector_offset, size);
+        } else {
+            memcpy(buffer, (uint8_t *)(XIP_BASE + ftl_get_sector_offset(sector) + sector_offset), size);
+        }
+
+        buffer += size;
+        addr += size;
+    }
     return true;
 }
 
@@ -161,63 +572,135 @@ bool flash_fatfs_read(int block, uint8_t *buffer, size_t buffer_size) {
 /**
  * Write data in buffer to specific block
  * 
+ * The data goes into the sector cache. A sector gets written into flash once
+ * all its blocks are written, otherwise it will be written later
+ * 
  * @param block The block offset
  * @param buffer Pointer to buffer
  * @param buffer_size Size of buffer
  * @return true if write succeed
  */
 bool flash_fatfs_write(int block, uint8_t *buffer, size_t buffer_size) {
-    
-    control_led(true, 0);
-    
-    // Calculate the start and end flash sector
-    uint32_t start_addr = block * FAT_BLOCK_SIZE;
-    uint32_t end_addr = start_addr + buffer_size;
-    int start_flash_sector = start_addr / FLASH_SECTOR_SIZE;
-    int end_flash_sector = (end_addr - 1) / FLASH_SECTOR_SIZE;
-    
-    // Temporary buffer for storing a whole flash sector
-    uint8_t sector_buffer[FLASH_SECTOR_SIZE];
-    
-    // Temporarily disable USB and interrupts to avoid interference
-    stdio_set_driver_enabled(&stdio_usb, false);
-    uint32_t ints = save_and_disable_interrupts();
-    
-    // Process every affected flash sector
-    for (int curr_sector = start_flash_sector; curr_sector <= end_flash_sector; curr_sector++) {
-        // Read current flash sector
-        uint32_t curr_sector_addr = FLASH_FAT_OFFSET + (curr_sector * FLASH_SECTOR_SIZE);
-        memcpy(sector_buffer, (uint8_t *)(XIP_BASE + curr_sector_addr), FLASH_SECTOR_SIZE);
-        
-        // Calculate the range to be updated in current sector
-        uint32_t sector_start_offset = (curr_sector == start_flash_sector) ? 
-            (start_addr % FLASH_SECTOR_SIZE) : 0;
-        uint32_t sector_end_offset = (curr_sector == end_flash_sector) ? 
-            (end_addr % FLASH_SECTOR_SIZE) : FLASH_SECTOR_SIZE;
-        if (sector_end_offset == 0) sector_end_offset = FLASH_SECTOR_SIZE;
-        
-        // Calculate the data offset in source buffer for the current flash sector
-        uint32_t buffer_offset = (curr_sector * FLASH_SECTOR_SIZE + sector_start_offset) - start_addr;
-        
-        // Update sector buffer acordingly
-        uint32_t update_size = sector_end_offset - sector_start_offset;
-        memcpy(sector_buffer + sector_start_offset, 
-               buffer + buffer_offset, 
-               update_size);
-        
-        //debug_log("Update flash sector %d from %d to %d\n", curr_sector, sector_start_offset, sector_start_offset + update_size);       
-        
-        
-        // Erase and rewrite the whole sector
-        flash_range_erase(curr_sector_addr, FLASH_SECTOR_SIZE);
-        flash_range_program(curr_sector_addr, sector_buffer, FLASH_SECTOR_SIZE);
+    uint32_t addr = block * FAT_BLOCK_SIZE;
+    uint32_t end_addr = addr + buffer_size;
+
+    while (addr < end_addr) {
+        int sector = addr / FLASH_SECTOR_SIZE;
+        uint32_t sector_offset = addr % FLASH_SECTOR_SIZE;
+        uint32_t size = FLASH_SECTOR_SIZE - sector_offset;
+        if (size > end_addr - addr) {
+            size = end_addr - addr;
+        }
+
+        flash_cache_entry_t *entry = cache_find(sector);
+        if (!entry) {
+            entry = cache_load(sector, size < FLASH_SECTOR_SIZE);
+        }
+        memcpy(entry->data + sector_offset, buffer, size);
+        entry->dirty = true;
+
+        // Commit the sector as soon as it is completely written
+        for (uint32_t i = sector_offset; i < sector_offset + size; i += FAT_BLOCK_SIZE) {
+            entry->written |= (1 << (i / FAT_BLOCK_SIZE));
+        }
+        if (entry->written == FLASH_ALL_BLOCKS_WRITTEN) {
+            cache_flush_entry(entry, false);
+        }
+
+        buffer += size;
+        addr += size;
     }
-        
-    // Restore interupts and USB
-    restore_interrupts(ints);
-    stdio_set_driver_enabled(&stdio_usb, true);
-    
-    control_led(false, 0);
-    
+
+    last_cache_write_time = get_absolute_time();
     return true;
-}
\ No newline at end of file
+}
+
+
+/**
+ * Write data from USB host to specific block
+ * 
+ * Same as flash_fatfs_write(), and the written sectors are not pre-erased until
+ * their clusters are seen allocated in FAT, because the host may write the data
+ * of a file before it updates FAT
+ * 
+ * @param block The block offset
+ * @param buffer Pointer to buffer
+ * @param buffer_size Size of buffer
+ * @return true if write succeed
+ */
+bool flash_fatfs_host_write(int block, uint8_t *buffer, size_t buffer_size) {
+    uint32_t first_sector = block * FAT_BLOCK_SIZE / FLASH_SECTOR_SIZE;
+    uint32_t last_sector = (block * FAT_BLOCK_SIZE + buffer_size - 1) / FLASH_SECTOR_SIZE;
+    for (uint32_t sector = first_sector; sector <= last_sector && sector < FTL_LOGICAL_SECTORS; sector++) {
+        host_written[sector / 8] |= (1 << (sector % 8));
+    }
+    host_writes++;
+    last_host_write_time = get_absolute_time();
+    return flash_fatfs_write(block, buffer, buffer_size);
+}
+
+
+/**
+ * Write all dirty sectors in cache into flash
+ * 
+ * Sectors that need an erased sector stay in cache until one is prepared in
+ * background, unless writing is forced
+ * 
+ * @param force true to write every sector now (erasing in place if necessary), e.g. before power off
+ */
+void flash_fatfs_flush(bool force) {
+    for (int i = 0; i < FLASH_CACHE_SECTORS; i++) {
+        cache_flush_entry(&cache[i], force);
+    }
+}
+
+
+/**
+ * Get the statistics of flash writing
+ * 
+ * @param out Pointer to the statistics to fill
+ */
+void flash_get_stats(flash_stats_t *out) {
+    *out = stats;
+}
+
+
+/**
+ * Print the statistics of flash writing and FTL to log
+ */
+void flash_print_stats(void) {
+    ftl_stats_t ftl;
+    ftl_get_stats(&ftl);
+    log_info("Flash: erases=%u, avoided=%u, skipped=%u, pages=%u, deferred=%u, relocated=%u, max IRQ off=%uus\n",
+              stats.erases, stats.erases_avoided, stats.sectors_skipped, stats.pages_programmed,
+              stats.writes_deferred, stats.sectors_relocated, stats.max_irq_off_us);
+    log_info("Free sectors: pre-erased=%u (%u with USB drive mounted), ready=%u\n",
+              stats.sectors_pre_erased, stats.sectors_pre_erased_mounted, stats.free_sectors_erased);
+    log_info("FTL: relocations=%u, wear levelings=%u, GC erases=%u, snapshots=%u, journal=%u, free=%u, dirty=%u, max IRQ off=%uus\n",
+              ftl.relocations, ftl.wear_levelings, ftl.gc_erases, ftl.snapshots, ftl.journal_records,
+              ftl.free_sectors, ftl.dirty_sectors, ftl.max_irq_off_us);
+}
+
+
+/**
+ * Flush the sector cache if no write happened for a while
+ */
+void process_flash_task(void) {
+    bool cache_idle = absolute_time_diff_us(last_cache_write_time, get_absolute_time()) >= FLASH_CACHE_IDLE_FLUSH_US;
+    if (cache_idle) {
+        flash_fatfs_flush(false);
+    }
+
+    // Erase unused sectors in background, when Raspberry Pi is not talking via I2C
+    // A short pause is enough if sectors are waiting for erased ones, and that can't wait for
+    // the cache to become idle: during a long copy, evicting a waiting sector would erase in place
+    if (ftl_is_gc_urgent()) {
+        if (i2c_get_idle_time_us() >= FLASH_GC_URGENT_I2C_IDLE_US) {
+            ftl_process();
+        }
+    } else if (cache_idle && i2c_get_idle_time_us() >= FLASH_GC_I2C_IDLE_US) {
+        if (!ftl_process()) {
+            pre_erase_slice();
+        }
+    }
+}
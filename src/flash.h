@@ -19,6 +19,20 @@
 #define FAT_BLOCK_SIZE         512
 
 
+typedef struct {
+    uint32_t erases;            // Number of sectors erased in place while writing (forced writes only)
+    uint32_t erases_avoided;    // Number of sector writes that needed no erase
+    uint32_t sectors_skipped;   // Number of sector writes with identical data
+    uint32_t pages_programmed;  // Number of programmed 256-byte pages
+    uint32_t max_irq_off_us;    // Longest time with interrupts disabled for flash writing
+    uint32_t sectors_pre_erased;    // Number of free sectors erased in advance
+    uint32_t sectors_pre_erased_mounted;    // Number of free sectors erased in advance while USB drive is mounted
+    uint32_t free_sectors_erased;   // Number of free sectors found erased in last full scan
+    uint32_t writes_deferred;   // Number of sector writes put off until an erased sector is ready
+    uint32_t sectors_relocated; // Number of sector writes that went to a spare sector instead of erasing
+} flash_stats_t;
+
+
 /**
  * Write 4k sector into flash
  * 
@@ -63,4 +77,50 @@ bool flash_fatfs_read(int block, uint8_t *buffer, size_t buffer_size);
 bool flash_fatfs_write(int block, uint8_t *buffer, size_t buffer_size);
 
 
+/**
+ * Write data from USB host to specific block
+ * 
+ * Same as flash_fatfs_write(), and the written sectors are not pre-erased until
+ * their clusters are seen allocated in FAT, because the host may write the data
+ * of a file before it updates FAT
+ * 
+ * @param block The block offset
+ * @param buffer Pointer to buffer
+ * @param buffer_size Size of buffer
+ * @return true if write succeed
+ */
+bool flash_fatfs_host_write(int block, uint8_t *buffer, size_t buffer_size);
+
+
+/**
+ * Write all dirty sectors in cache into flash
+ * 
+ * Sectors that need an erased sector stay in cache until one is prepared in
+ * background, unless writing is forced
+ * 
+ * @param force true to write every sector now (erasing in place if necessary), e.g. before power off
+ */
+void flash_fatfs_flush(bool force);
+
+
+/**
+ * Get the statistics of flash writing
+ * 
+ * @param out Pointer to the statistics to fill
+ */
+void flash_get_stats(flash_stats_t *out);
+
+
+/**
+ * Print the statistics of flash writing and FTL to log
+ */
+void flash_print_stats(void);
+
+
+/**
+ * Process the flash task (flush the sector cache when idle)
+ */
+void process_flash_task(void);
+
+
 #endif
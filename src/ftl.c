@@ -0,0 +1,476 @@
+#include <stddef.h>
+#include "ftl.h"
+#include "log.h"
+#include "util.h"
+
+
+#define LOG_MODULE          "ftl"
+
+
+#define FTL_MAGIC                0x4C544657  // "WFTL"
+#define FTL_VERSION              1
+
+#define FTL_SNAPSHOT_OFFSET      FLASH_PAGE_SIZE
+#define FTL_SNAPSHOT_SIZE        (FTL_LOGICAL_SECTORS * sizeof(uint16_t))
+#define FTL_JOURNAL_OFFSET       (FTL_SNAPSHOT_OFFSET + FTL_SNAPSHOT_SIZE)
+#define FTL_JOURNAL_RECORDS      ((FTL_MAP_BANK_SIZE - FTL_JOURNAL_OFFSET) / sizeof(ftl_record_t))
+
+#define FTL_WEAR_LEVEL_INTERVAL  64    // Move one cold sector after every 64 relocations
+
+#define FTL_FREE_RESERVE         2     // Erased sectors only used by writes that cannot wait
+#define FTL_SNAPSHOT_THRESHOLD   (FTL_JOURNAL_RECORDS * 3 / 4)   // Prepare next snapshot in background from here
+
+#define PHYS_USED                0     // Mapped to a logical sector
+#define PHYS_FREE                1     // Erased and ready for writing
+#define PHYS_DIRTY               2     // Not mapped, waiting for erasing
+
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t logical_sectors;
+    uint32_t seq;
+    uint32_t map_crc;
+    uint32_t header_crc;
+} ftl_header_t;
+
+typedef struct {
+    uint16_t logical;
+    uint16_t physical;
+    uint16_t logical_inv;
+    uint16_t physical_inv;
+} ftl_record_t;
+
+
+static uint16_t map[FTL_LOGICAL_SECTORS];
+
+static uint8_t phys_state[FTL_PHYSICAL_SECTORS];
+
+static int active_bank = -1;
+
+static uint32_t bank_seq = 0;
+
+static uint32_t journal_index = 0;
+
+static int free_cursor = 0;
+
+static int free_count = 0;
+
+static int next_bank_erased = 0;    // Number of sectors in the other bank erased for next snapshot
+
+static int dirty_cursor = 0;
+
+static int wear_level_cursor = 0;
+
+static int relocations_since_wear_level = 0;
+
+static uint8_t page_buffer[FLASH_PAGE_SIZE];
+
+static uint8_t sector_buffer[FLASH_SECTOR_SIZE];
+
+static ftl_stats_t stats = {0};
+
+
+// Get flash offset of given physical sector
+static uint32_t phys_offset(uint32_t phys) {
+    if (phys < FTL_LOGICAL_SECTORS) {
+        return FLASH_FAT_OFFSET + phys * FLASH_SECTOR_SIZE;
+    }
+    return FTL_SPARE_OFFSET + (phys - FTL_LOGICAL_SECTORS) * FLASH_SECTOR_SIZE;
+}
+
+
+// Get flash offset of given map bank
+static uint32_t bank_offset(int bank) {
+    return FTL_TAIL_OFFSET + bank * FTL_MAP_BANK_SIZE;
+}
+
+
+// Check whether the data is fully erased
+static bool is_blank(const uint8_t *data, size_t size) {
+    const uint32_t *d = (const uint32_t *)data;
+    for (size_t i = 0; i < size / 4; i++) {
+        if (d[i] != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Keep the longest time that interrupts were disabled
+static void record_irq_off_time(uint64_t start) {
+    uint32_t duration = (uint32_t)(time_us_64() - start);
+    if (duration > stats.max_irq_off_us) {
+        stats.max_irq_off_us = duration;
+    }
+}
+
+
+/**
+ * Erase flash sectors, interrupts are disabled for one sector at a time
+ *
+ * @param offset The flash offset (sector aligned)
+ * @param size Number of bytes to erase (multiple of sector size)
+ */
+void ftl_erase_flash(uint32_t offset, size_t size) {
+    stdio_set_driver_enabled(&stdio_usb, false);
+    for (size_t i = 0; i < size; i += FLASH_SECTOR_SIZE) {
+        uint32_t ints = save_and_disable_interrupts();
+        uint64_t start = time_us_64();
+        flash_range_erase(offset + i, FLASH_SECTOR_SIZE);
+        record_irq_off_time(start);
+        restore_interrupts(ints);
+    }
+    stdio_set_driver_enabled(&stdio_usb, true);
+}
+
+
+/**
+ * Program flash pages, interrupts are disabled for one page at a time
+ *
+ * @param offset The flash offset (page aligned)
+ * @param data Pointer to data in RAM
+ * @param size Number of bytes to program (multiple of page size)
+ */
+void ftl_program_flash(uint32_t offset, const uint8_t *data, size_t size) {
+    stdio_set_driver_enabled(&stdio_usb, false);
+    for (size_t i = 0; i < size; i += FLASH_PAGE_SIZE) {
+        uint32_t ints = save_and_disable_interrupts();
+        uint64_t start = time_us_64();
+        flash_range_program(offset + i, data + i, FLASH_PAGE_SIZE);
+        record_irq_off_time(start);
+        restore_interrupts(ints);
+    }
+    stdio_set_driver_enabled(&stdio_usb, true);
+}
+
+
+// Check whether the map bank has valid header and snapshot
+static bool bank_valid(int bank, uint32_t *seq) {
+    const uint8_t *base = (const uint8_t *)(XIP_BASE + bank_offset(bank));
+    ftl_header_t header;
+    memcpy(&header, base, sizeof(header));
+    if (header.magic != FTL_MAGIC || header.version != FTL_VERSION || header.logical_sectors != FTL_LOGICAL_SECTORS) {
+        return false;
+    }
+    if (header.header_crc != crc32((const uint8_t *)&header, offsetof(ftl_header_t, header_crc))) {
+        return false;
+    }
+    if (header.map_crc != crc32(base + FTL_SNAPSHOT_OFFSET, FTL_SNAPSHOT_SIZE)) {
+        return false;
+    }
+    *seq = header.seq;
+    return true;
+}
+
+
+// Erase one more sector of the other bank for next snapshot
+static void erase_next_bank_sector(void) {
+    int bank = (active_bank == 0) ? 1 : 0;
+    ftl_erase_flash(bank_offset(bank) + next_bank_erased * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+    next_bank_erased++;
+}
+
+
+// Write the whole map into the other bank, header goes last so the bank only becomes valid when complete
+static void write_snapshot(void) {
+    int bank = (active_bank == 0) ? 1 : 0;
+    uint32_t offset = bank_offset(bank);
+
+    // Sectors erased in advance by ftl_process() are not erased again
+    while (next_bank_erased < FTL_MAP_BANK_SECTORS) {
+        erase_next_bank_sector();
+    }
+    ftl_program_flash(offset + FTL_SNAPSHOT_OFFSET, (const uint8_t *)map, FTL_SNAPSHOT_SIZE);
+
+    ftl_header_t header = {
+        .magic = FTL_MAGIC,
+        .version = FTL_VERSION,
+        .logical_sectors = FTL_LOGICAL_SECTORS,
+        .seq = bank_seq + 1,
+        .map_crc = crc32((const uint8_t *)map, FTL_SNAPSHOT_SIZE),
+    };
+    header.header_crc = crc32((const uint8_t *)&header, offsetof(ftl_header_t, header_crc));
+    memset(page_buffer, 0xFF, FLASH_PAGE_SIZE);
+    memcpy(page_buffer, &header, sizeof(header));
+    ftl_program_flash(offset, page_buffer, FLASH_PAGE_SIZE);
+
+    active_bank = bank;
+    bank_seq = header.seq;
+    journal_index = 0;
+    next_bank_erased = 0;
+    stats.snapshots++;
+}
+
+
+// Persist the mapping of one logical sector, the journal must not be full
+static void append_record(int logical, int physical) {
+    ftl_record_t record = {
+        .logical = logical,
+        .physical = physical,
+        .logical_inv = ~logical,
+        .physical_inv = ~physical,
+    };
+    // Only the bytes of this record get programmed, the rest of page keeps unchanged
+    uint32_t record_offset = FTL_JOURNAL_OFFSET + journal_index * sizeof(ftl_record_t);
+    uint32_t page_offset = record_offset & ~(FLASH_PAGE_SIZE - 1);
+    memset(page_buffer, 0xFF, FLASH_PAGE_SIZE);
+    memcpy(page_buffer + (record_offset - page_offset), &record, sizeof(record));
+    ftl_program_flash(bank_offset(active_bank) + page_offset, page_buffer, FLASH_PAGE_SIZE);
+    journal_index++;
+}
+
+
+// Replay the journal of active bank on top of its snapshot
+static void replay_journal(void) {
+    const ftl_record_t *records = (const ftl_record_t *)(XIP_BASE + bank_offset(active_bank) + FTL_JOURNAL_OFFSET);
+    uint32_t i;
+    for (i = 0; i < FTL_JOURNAL_RECORDS; i++) {
+        ftl_record_t record = records[i];
+        if (is_blank((const uint8_t *)&record, sizeof(record))) {
+            break;
+        }
+        // Skip the record that was not completely written
+        if ((uint16_t)(record.logical ^ record.logical_inv) != 0xFFFF || (uint16_t)(record.physical ^ record.physical_inv) != 0xFFFF) {
+            continue;
+        }
+        if (record.logical < FTL_LOGICAL_SECTORS && record.physical < FTL_PHYSICAL_SECTORS) {
+            map[record.logical] = record.physical;
+        }
+    }
+    journal_index = i;
+}
+
+
+// Find out the state of every physical sector according to the map
+static void scan_physical_sectors(void) {
+    memset(phys_state, PHYS_DIRTY, sizeof(phys_state));
+    for (uint32_t i = 0; i < FTL_LOGICAL_SECTORS; i++) {
+        phys_state[map[i]] = PHYS_USED;
+    }
+    free_count = 0;
+    for (uint32_t i = 0; i < FTL_PHYSICAL_SECTORS; i++) {
+        if (phys_state[i] != PHYS_USED && is_blank((const uint8_t *)(XIP_BASE + phys_offset(i)), FLASH_SECTOR_SIZE)) {
+            phys_state[i] = PHYS_FREE;
+            free_count++;
+        }
+    }
+}
+
+
+// Count the sectors of the other bank that are already erased for next snapshot
+static void scan_next_bank(void) {
+    const uint8_t *base = (const uint8_t *)(XIP_BASE + bank_offset((active_bank == 0) ? 1 : 0));
+    next_bank_erased = 0;
+    while (next_bank_erased < FTL_MAP_BANK_SECTORS && is_blank(base + next_bank_erased * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE)) {
+        next_bank_erased++;
+    }
+}
+
+
+// Mark physical sector as no longer used, it needs erasing unless it is still blank
+static void release_sector(int phys) {
+    if (is_blank((const uint8_t *)(XIP_BASE + phys_offset(phys)), FLASH_SECTOR_SIZE)) {
+        phys_state[phys] = PHYS_FREE;
+        free_count++;
+    } else {
+        phys_state[phys] = PHYS_DIRTY;
+    }
+}
+
+
+// Erase one dirty sector, return its index or -1 if there is none
+static int erase_dirty_sector(void) {
+    for (uint32_t n = 0; n < FTL_PHYSICAL_SECTORS; n++) {
+        int i = (dirty_cursor + n) % FTL_PHYSICAL_SECTORS;
+        if (phys_state[i] == PHYS_DIRTY) {
+            ftl_erase_flash(phys_offset(i), FLASH_SECTOR_SIZE);
+            phys_state[i] = PHYS_FREE;
+            free_count++;
+            dirty_cursor = (i + 1) % FTL_PHYSICAL_SECTORS;
+            stats.gc_erases++;
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+// Take an erased sector for writing, return its index or -1 if there is none
+static int take_free_sector(void) {
+    for (uint32_t n = 0; n < FTL_PHYSICAL_SECTORS; n++) {
+        int i = (free_cursor + n) % FTL_PHYSICAL_SECTORS;
+        if (phys_state[i] == PHYS_FREE) {
+            free_cursor = (i + 1) % FTL_PHYSICAL_SECTORS;
+            free_count--;
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Load the sector map from flash, or create it if there is no valid one
+ */
+void ftl_init(void) {
+    uint32_t seq[2];
+    bool valid[2];
+    for (int i = 0; i < 2; i++) {
+        valid[i] = bank_valid(i, &seq[i]);
+    }
+
+    if (valid[0] || valid[1]) {
+        active_bank = (valid[0] && (!valid[1] || (int32_t)(seq[0] - seq[1]) > 0)) ? 0 : 1;
+        bank_seq = seq[active_bank];
+        memcpy(map, (const uint8_t *)(XIP_BASE + bank_offset(active_bank) + FTL_SNAPSHOT_OFFSET), FTL_SNAPSHOT_SIZE);
+        replay_journal();
+        scan_physical_sectors();
+        scan_next_bank();
+    } else {
+        // No map yet, keep the existing FAT data where it is
+        log_warn("No valid sector map found, create new one.\n");
+        ftl_format();
+    }
+}
+
+
+/**
+ * Reset the sector map to identity mapping (used when formatting the disk)
+ */
+void ftl_format(void) {
+    for (uint32_t i = 0; i < FTL_LOGICAL_SECTORS; i++) {
+        map[i] = i;
+    }
+    scan_physical_sectors();
+    write_snapshot();
+}
+
+
+/**
+ * Get the flash offset of a logical sector
+ *
+ * @param sector The logical sector index
+ * @return The offset of the physical sector in flash
+ */
+uint32_t ftl_get_sector_offset(int sector) {
+    return phys_offset(map[sector]);
+}
+
+
+/**
+ * Check whether a sector can be written now, without erasing anything
+ *
+ * @param use_reserve Whether the erased sectors kept for writes that cannot wait may be used
+ * @return true if an erased sector and journal space are ready
+ */
+bool ftl_can_write_sector(bool use_reserve) {
+    return free_count > (use_reserve ? 0 : FTL_FREE_RESERVE) && journal_index < FTL_JOURNAL_RECORDS;
+}
+
+
+/**
+ * Check whether garbage collection should not wait for long idle time
+ *
+ * @return true if erased sectors are running out or the journal needs a new snapshot
+ */
+bool ftl_is_gc_urgent(void) {
+    return free_count <= FTL_FREE_RESERVE || journal_index >= FTL_SNAPSHOT_THRESHOLD;
+}
+
+
+/**
+ * Write the whole logical sector into a spare sector and remap it
+ *
+ * Nothing is erased here, the sector is not written if no erased sector or journal space is ready
+ *
+ * @param sector The logical sector index
+ * @param data Pointer to the 4k sector data
+ * @param use_reserve Whether the erased sectors kept for writes that cannot wait may be used
+ * @return true if written successfully
+ */
+bool ftl_write_sector(int sector, const uint8_t *data, bool use_reserve) {
+    if (!ftl_can_write_sector(use_reserve)) {
+        return false;
+    }
+    int new_phys = take_free_sector();
+    int old_phys = map[sector];
+
+    // Write data first, the mapping only changes after the record is written
+    uint32_t offset = phys_offset(new_phys);
+    for (uint32_t i = 0; i < FLASH_SECTOR_SIZE; i += FLASH_PAGE_SIZE) {
+        if (!is_blank(data + i, FLASH_PAGE_SIZE)) {
+            ftl_program_flash(offset + i, data + i, FLASH_PAGE_SIZE);
+        }
+    }
+    phys_state[new_phys] = PHYS_USED;
+    map[sector] = new_phys;
+    append_record(sector, new_phys);
+    release_sector(old_phys);
+
+    stats.relocations++;
+    relocations_since_wear_level++;
+    return true;
+}
+
+
+/**
+ * Erase the physical sector of a logical sector whose content is no longer needed
+ *
+ * @param sector The logical sector index
+ */
+void ftl_erase_sector(int sector) {
+    ftl_erase_flash(phys_offset(map[sector]), FLASH_SECTOR_SIZE);
+}
+
+
+/**
+ * Do one step of garbage collection or wear leveling
+ *
+ * @return true if some flash operation was performed
+ */
+bool ftl_process(void) {
+    if (erase_dirty_sector() >= 0) {
+        return true;
+    }
+    if (journal_index >= FTL_SNAPSHOT_THRESHOLD) {
+        // One erase per step, the snapshot is written once the other bank is erased
+        if (next_bank_erased < FTL_MAP_BANK_SECTORS) {
+            erase_next_bank_sector();
+        } else {
+            write_snapshot();
+        }
+        return true;
+    }
+    if (relocations_since_wear_level >= FTL_WEAR_LEVEL_INTERVAL && ftl_can_write_sector(false)) {
+        // Move a cold sector, so its physical sector can also take part in writing
+        int sector = wear_level_cursor;
+        wear_level_cursor = (wear_level_cursor + 1) % FTL_LOGICAL_SECTORS;
+        memcpy(sector_buffer, (const uint8_t *)(XIP_BASE + ftl_get_sector_offset(sector)), FLASH_SECTOR_SIZE);
+        if (ftl_write_sector(sector, sector_buffer, false)) {
+            stats.wear_levelings++;
+        }
+        relocations_since_wear_level = 0;
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ * Get the statistics of the flash translation layer
+ *
+ * @param out Pointer to the statistics to fill
+ */
+void ftl_get_stats(ftl_stats_t *out) {
+    stats.journal_records = journal_index;
+    stats.free_sectors = free_count;
+    stats.dirty_sectors = 0;
+    for (uint32_t i = 0; i < FTL_PHYSICAL_SECTORS; i++) {
+        if (phys_state[i] == PHYS_DIRTY) {
+            stats.dirty_sectors++;
+        }
+    }
+    *out = stats;
+}
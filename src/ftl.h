@@ -0,0 +1,148 @@
+#ifndef _FTL_H_
+#define _FTL_H_
+
+#include "flash.h"
+
+
+// Flash translation layer for the FAT volume
+//
+// Logical 4k sectors of the FAT volume are mapped to physical flash sectors.
+// A rewritten sector is programmed into a pre-erased spare sector and then
+// remapped, the old physical sector gets erased in background later. Writing
+// never erases: without an erased sector or journal space the write is refused,
+// and the map snapshot is prepared and written in background too.
+//
+// Physical sectors 0~3583 are the original FAT region (identity mapped after
+// formatting), physical sectors 3584~3591 are spare sectors in the tail area.
+//
+// Tail area (64KB after the FAT region):
+//   sector 0~2:  map bank A
+//   sector 3~5:  map bank B
+//   sector 6~13: spare sectors
+//   sector 14~15: reserved for configuration store
+//
+// Map bank:
+//   page 0:      header
+//   page 1~28:   map snapshot (one uint16 physical index per logical sector)
+//   page 29~47:  journal (8-byte records appended after the snapshot)
+
+#define FTL_TAIL_OFFSET          (FLASH_FAT_OFFSET + FAT_BLOCK_NUM * FAT_BLOCK_SIZE)
+
+#define FTL_LOGICAL_SECTORS      (FAT_BLOCK_NUM * FAT_BLOCK_SIZE / FLASH_SECTOR_SIZE)
+#define FTL_SPARE_SECTORS        8
+#define FTL_PHYSICAL_SECTORS     (FTL_LOGICAL_SECTORS + FTL_SPARE_SECTORS)
+
+#define FTL_MAP_BANK_SECTORS     3
+#define FTL_MAP_BANK_SIZE        (FTL_MAP_BANK_SECTORS * FLASH_SECTOR_SIZE)
+#define FTL_SPARE_OFFSET         (FTL_TAIL_OFFSET + 2 * FTL_MAP_BANK_SIZE)
+#define FTL_RESERVED_OFFSET      (FTL_SPARE_OFFSET + FTL_SPARE_SECTORS * FLASH_SECTOR_SIZE)
+#define FTL_RESERVED_SECTORS     2
+
+
+typedef struct {
+    uint32_t relocations;       // Number of sectors written into spare sectors
+    uint32_t wear_levelings;    // Number of cold sectors moved for wear leveling
+    uint32_t gc_erases;         // Number of physical sectors erased by garbage collection
+    uint32_t snapshots;         // Number of map snapshots written
+    uint32_t journal_records;   // Number of records in current journal
+    uint16_t free_sectors;      // Number of erased sectors ready for writing
+    uint16_t dirty_sectors;     // Number of sectors waiting for erasing
+    uint32_t max_irq_off_us;    // Longest time with interrupts disabled for erasing or programming
+} ftl_stats_t;
+
+
+/**
+ * Load the sector map from flash, or create it if there is no valid one
+ */
+void ftl_init(void);
+
+
+/**
+ * Reset the sector map to identity mapping (used when formatting the disk)
+ */
+void ftl_format(void);
+
+
+/**
+ * Get the flash offset of a logical sector
+ *
+ * @param sector The logical sector index
+ * @return The offset of the physical sector in flash
+ */
+uint32_t ftl_get_sector_offset(int sector);
+
+
+/**
+ * Check whether a sector can be written now, without erasing anything
+ *
+ * @param use_reserve Whether the erased sectors kept for writes that cannot wait may be used
+ * @return true if an erased sector and journal space are ready
+ */
+bool ftl_can_write_sector(bool use_reserve);
+
+
+/**
+ * Check whether garbage collection should not wait for long idle time
+ *
+ * @return true if erased sectors are running out or the journal needs a new snapshot
+ */
+bool ftl_is_gc_urgent(void);
+
+
+/**
+ * Write the whole logical sector into a spare sector and remap it
+ *
+ * Nothing is erased here, the sector is not written if no erased sector or journal space is ready
+ *
+ * @param sector The logical sector index
+ * @param data Pointer to the 4k sector data
+ * @param use_reserve Whether the erased sectors kept for writes that cannot wait may be used
+ * @return true if written successfully
+ */
+bool ftl_write_sector(int sector, const uint8_t *data, bool use_reserve);
+
+
+/**
+ * Erase the physical sector of a logical sector whose content is no longer needed
+ *
+ * @param sector The logical sector index
+ */
+void ftl_erase_sector(int sector);
+
+
+/**
+ * Do one step of garbage collection or wear leveling
+ *
+ * @return true if some flash operation was performed
+ */
+bool ftl_process(void);
+
+
+/**
+ * Erase flash sectors, interrupts are disabled for one sector at a time
+ *
+ * @param offset The flash offset (sector aligned)
+ * @param size Number of bytes to erase (multiple of sector size)
+ */
+void ftl_erase_flash(uint32_t offset, size_t size);
+
+
+/**
+ * Program flash pages, interrupts are disabled for one page at a time
+ *
+ * @param offset The flash offset (page aligned)
+ * @param data Pointer to data in RAM
+ * @param size Number of bytes to program (multiple of page size)
+ */
+void ftl_program_flash(uint32_t offset, const uint8_t *data, size_t size);
+
+
+/**
+ * Get the statistics of the flash translation layer
+ *
+ * @param out Pointer to the statistics to fill
+ */
+void ftl_get_stats(ftl_stats_t *out);
+
+
+#endif
@@ -16,6 +16,7 @@
 #include "conf.h"
 #include "log.h"
 #include "fatfs_disk.h"
+#include "flash.h"
 #include "usb_msc_device.h"
 #include "power.h"
 
@@ -236,19 +237,25 @@ bool hibernate_can_enter(void) {
 }
 
 static void hibernate_flush_persistent_tasks(void) {
-    process_log_task();
     process_conf_task();
 
-    if (!is_usb_msc_device_mounted() && is_fatfs_mounted()) {
-        // Force RAM configuration to be synchronized before hibernation.
+    // Changes made on USB drive are loaded before hibernation
+    if (!is_usb_msc_device_mounted() && is_fatfs_mounted() && conf_is_sync_needed()) {
         conf_sync();
+    }
 
-        if (is_log_saving_to_file()) {
-            save_logs_to_file();
-        }
+    // Log not saved yet is kept in persistent RAM and saved after wakeup, unless it is nearly full
+    log_print_pending();
+    if (!is_usb_msc_device_mounted() && is_fatfs_mounted() && is_log_saving_to_file() && !log_can_defer_saving()) {
+        save_logs_to_file();
     }
 
-    process_log_task();
+    // Configuration changed just now is not in binary store yet
+    conf_save_binary();
+
+    // Cached sectors will be lost when powered off
+    flash_fatfs_flush(true);
+
     stdio_flush();
 }
 
@@ -298,7 +305,18 @@ int hibernate_enter(void) {
     bool vin_recoverable = power_is_vin_recoverable();
     powman_hw->scratch[HIBERNATE_SCRATCH_CONTEXT] = hibernate_make_context(rtc_alarm_type, vin_recoverable);
 
-    bool valid_state = powman_configure_wakeup_state(off_state, on_state);
+    // Keep the SRAM bank of persistent log powered if it has log not saved to file yet
+    // The log never crosses banks (checked in log.c), and the bank costs retention current in sleep
+    powman_power_state sleep_state = off_state;
+    powman_power_state wake_state = on_state;
+    if (log_get_persist_pending() > 0) {
+        enum powman_power_domains bank = (uintptr_t)log_get_persist_address() < SRAM4_BASE
+            ? POWMAN_POWER_DOMAIN_SRAM_BANK0 : POWMAN_POWER_DOMAIN_SRAM_BANK1;
+        sleep_state = powman_power_state_with_domain_on(sleep_state, bank);
+        wake_state = powman_power_state_with_domain_on(wake_state, bank);
+    }
+
+    bool valid_state = powman_configure_wakeup_state(sleep_state, wake_state);
     if (!valid_state) {
         return PICO_ERROR_INVALID_STATE;
     }
@@ -315,7 +333,7 @@ int hibernate_enter(void) {
 
     hibernate_release_i2c_bus();
 
-    int rc = powman_set_power_state(off_state);
+    int rc = powman_set_power_state(sleep_state);
     if (rc != PICO_OK) {
         hibernating = false;
         powman_hw->scratch[HIBERNATE_SCRATCH_CONTEXT] = 0;
@@ -22,6 +22,8 @@
 #include "util.h"
 #include "file_admin.h"
 
+#define LOG_MODULE          "i2c"
+
 
 #define PRODUCT_INFO_STR        PRODUCT_NAME " (Firmware: V" TO_STRING(FIRMWARE_VERSION_MAJOR) "." TO_STRING(FIRMWARE_VERSION_MINOR) ")\n"
 
@@ -44,6 +46,8 @@
 #define ADMIN_RPI_POWERING_OFF  2
 #define ADMIN_RPI_REBOOTING     3
 
+#define CONF_TXN_TIMEOUT_US     1000000 // Staged configuration writes are discarded if not committed in time
+
 #define CRC8_POLYNOMIAL			0x31	// CRC-8 Polynomial (x^8 + x^5 + x^4 + 1 -> 00110001 -> 0x31)
 
 /*
@@ -94,6 +98,8 @@ uint8_t tlow_lsb;
 uint8_t thigh_msb;
 uint8_t thigh_lsb;
 
+uint8_t log_tail_len_lsb;
+
 extern uint8_t heartbeat_missing_count;
 
 uint8_t download_buffer[DOWNLOAD_BUFFER_SIZE];
@@ -112,6 +118,16 @@ typedef struct {  // Pending command snapshot
     bool valid;
 } AdminCommandPending;
 
+static volatile uint32_t last_slave_event_us = 0;
+
+// Configuration writes staged between I2C_ADMIN_CONF_BEGIN and I2C_ADMIN_CONF_COMMIT
+static bool conf_txn_open = false;
+static uint32_t conf_txn_begin_us;
+static uint8_t conf_txn_count = 0;
+static conf_key_t conf_txn_keys[CONF_COUNT];
+static uint8_t conf_txn_values[CONF_COUNT];
+static bool conf_txn_applied = false;
+
 static volatile bool admin_cmd_pending = false;
 static volatile bool admin_cmd_running = false;
 static AdminCommandPending admin_cmd = {0};
@@ -181,14 +197,14 @@ static uint8_t pack_file_list(uint8_t dir) {
     FILINFO fno;
     fr = f_opendir(&dj, dir_names[dir]);
     if (fr != FR_OK) {
-        debug_log("Failed to open directory %s. Error code: %d\n", dir_names[dir], fr);
+        log_error("Failed to open directory %s. Error code: %d\n", dir_names[dir], fr);
         download_buffer_len = 0;
         download_buffer_index = 0;
         download_buffer[0] = '\0';
         return ADMIN_STATUS_IO_ERROR;
     }
 
-    debug_log("Listing files in directory: %s\n", dir_names[dir]);
+    log_debug("Listing files in directory: %s\n", dir_names[dir]);
 
     while (true) {
         fr = f_readdir(&dj, &fno);
@@ -213,7 +229,7 @@ static uint8_t pack_file_list(uint8_t dir) {
         // - Trailer: "|HH>" => 4 bytes
         int need = (first ? 0 : 1) + name_len + 4;
         if (index + need >= DOWNLOAD_BUFFER_SIZE) {
-            debug_log("Buffer is full and skip 1 or more files.\n");
+            log_warn("Buffer is full and skip 1 or more files.\n");
             break;
         }
 
@@ -229,7 +245,7 @@ static uint8_t pack_file_list(uint8_t dir) {
 
     // Append "|" (delimiter before CRC)
     if (index + 4 >= DOWNLOAD_BUFFER_SIZE) {
-        debug_log("Buffer is full and cannot append CRC.\n");
+        log_error("Buffer is full and cannot append CRC.\n");
         download_buffer_len = 0;
         download_buffer_index = 0;
         download_buffer[0] = '\0';
@@ -394,9 +410,9 @@ bool i2c_unpack_filename(char *input, char *output) {
 // Callback for applying schedule script
 int64_t apply_schedule_script_callback(alarm_id_t id, void *user_data) {
 	if (load_script(true)) {
-        debug_log("Load and run script OK\n");
+        log_info("Load and run script OK\n");
     } else {
-        debug_log("Load and run script failed\n");
+        log_error("Load and run script failed\n");
     }
     return 0;
 }
@@ -425,10 +441,10 @@ bool apply_schedule_script(int dir, char* filename) {
                 add_alarm_in_us(500000, apply_schedule_script_callback, NULL, true);
                 return true;
             } else {
-                debug_log("Failed to copy script: %s\n", buf);
+                log_error("Failed to copy script: %s\n", buf);
             }
         } else {
-            debug_log("Script file does not exist: %s\n", buf);
+            log_warn("Script file does not exist: %s\n", buf);
         }
     }
     return false;
@@ -446,7 +462,7 @@ static void queue_admin_command(uint8_t dir, uint8_t pwd, uint8_t cmd) {
     // Reject if a previous command is still pending/running
     if (admin_cmd_pending || admin_cmd_running) {
         i2c_admin_reg[I2C_ADMIN_CONTEXT - I2C_ADMIN_FIRST] = ADMIN_STATUS_BUSY;
-        debug_log("Admin CMD rejected: busy (pwd=0x%02x, cmd=0x%02x)\n", pwd, cmd);
+        log_warn("Admin CMD rejected: busy (pwd=0x%02x, cmd=0x%02x)\n", pwd, cmd);
         // Clear password/command like the old behavior
         i2c_admin_reg[I2C_ADMIN_PASSWORD - I2C_ADMIN_FIRST] = 0;
         i2c_admin_reg[I2C_ADMIN_COMMAND - I2C_ADMIN_FIRST] = 0;
@@ -482,13 +498,19 @@ static void run_admin_command_deferred(uint8_t dir, uint8_t pwd, uint8_t cmd) {
 
     switch (pwd_cmd) {
         case I2C_ADMIN_PWD_CMD_PRINT_PRODUCT_INFO:  // Print product name and firmware version
-            debug_log("Admin CMD: Print Product Info\n");
-            debug_log("%s\n", PRODUCT_INFO_STR);
+            log_info("Admin CMD: Print Product Info\n");
+            log_info("%s\n", PRODUCT_INFO_STR);
+            status = ADMIN_STATUS_OK;
+            break;
+
+        case I2C_ADMIN_PWD_CMD_PRINT_FLASH_STATS:   // Print flash writing statistics
+            log_info("Admin CMD: Print Flash Stats\n");
+            flash_print_stats();
             status = ADMIN_STATUS_OK;
             break;
 
         case I2C_ADMIN_PWD_CMD_FORMAT_DISK:         // Format the disk (all data will be gone!)
-            debug_log("Admin CMD: Format Disk\n");
+            log_info("Admin CMD: Format Disk\n");
             tud_msc_start_stop_cb(0, 0, false, true);
             unmount_fatfs();
             flash_fatfs_init();
@@ -498,39 +520,39 @@ static void run_admin_command_deferred(uint8_t dir, uint8_t pwd, uint8_t cmd) {
             break;
 
         case I2C_ADMIN_PWD_CMD_RESET_RTC:           // Reset RTC (time will lose!)
-            debug_log("Admin CMD: Reset RTC\n");
+            log_info("Admin CMD: Reset RTC\n");
             set_virtual_register(I2C_VREG_RX8025_CONTROL_REGISTER, BIT_VALUE(0));
             rtc_set_timestamp(0);
             status = ADMIN_STATUS_OK;
             break;
 
         case I2C_ADMIN_PWD_CMD_ENABLE_ID_EEPROM_WP: // Enable ID EEPROM write protection
-            debug_log("Admin CMD: Enable ID EEPROM WP\n");
+            log_info("Admin CMD: Enable ID EEPROM WP\n");
             id_eeprom_write_protection(true);
             status = ADMIN_STATUS_OK;
             break;
 
         case I2C_ADMIN_PWD_CMD_DISABLE_ID_EEPROM_WP:// Disable ID EEPROM write protection
-            debug_log("Admin CMD: Disable ID EEPROM WP\n");
+            log_info("Admin CMD: Disable ID EEPROM WP\n");
             id_eeprom_write_protection(false);
             status = ADMIN_STATUS_OK;
             break;
 
         case I2C_ADMIN_PWD_CMD_RESET_CONF:          // Reset configuration to default values
-            debug_log("Admin CMD: Reset Conf\n");
+            log_info("Admin CMD: Reset Conf\n");
             conf_reset();
             status = ADMIN_STATUS_OK;
             break;
 
         case I2C_ADMIN_PWD_CMD_SYNC_CONF:           // Synchronize configuration to file
-            debug_log("Admin CMD: Sync Conf\n");
+            log_info("Admin CMD: Sync Conf\n");
             tud_msc_start_stop_cb(0, 0, false, true);
             conf_sync();
             status = ADMIN_STATUS_OK;
             break;
 
         case I2C_ADMIN_PWD_CMD_SAVE_LOG:            // Save log to file
-            debug_log("Admin CMD: Save Log\n");
+            log_info("Admin CMD: Save Log\n");
             if (is_log_saving_to_file()) {
                 save_logs_to_file();
             }
@@ -538,61 +560,61 @@ static void run_admin_command_deferred(uint8_t dir, uint8_t pwd, uint8_t cmd) {
             break;
 
         case I2C_ADMIN_PWD_CMD_LOAD_SCRIPT:         // Load and generate schedule script files
-            debug_log("Admin CMD: Load Script\n");
+            log_info("Admin CMD: Load Script\n");
             load_script(false);
             status = ADMIN_STATUS_OK;
             break;
 
         case I2C_ADMIN_PWD_CMD_LIST_FILES:          // List files in specific directory
-            debug_log("Admin CMD: List Files\n");
+            log_info("Admin CMD: List Files\n");
             status = pack_file_list(dir);
             break;
 
         case I2C_ADMIN_PWD_CMD_CHOOSE_SCRIPT: {     // Choose schedule script
-            debug_log("Admin CMD: Choose Script\n");
+            log_info("Admin CMD: Choose Script\n");
             tud_msc_start_stop_cb(0, 0, false, true);
 
             // Validate and unpack filename packet from upload buffer
             if (!unpack_filename((char*)upload_buffer, (char*)upload_buffer)) {
-                debug_log("Choose script rejected: invalid packet\n");
+                log_warn("Choose script rejected: invalid packet\n");
                 status = ADMIN_STATUS_INVALID_PACKET;
                 break;
             }
 
-            debug_log("Applying script %s...\n", upload_buffer);
+            log_info("Applying script %s...\n", upload_buffer);
             bool ok = apply_schedule_script(dir, (char*)upload_buffer);
             status = ok ? ADMIN_STATUS_OK : ADMIN_STATUS_IO_ERROR;
             break;
         }
 
         case I2C_ADMIN_PWD_CMD_PURGE_SCRIPT:        // Purge schedule script
-            debug_log("Admin CMD: Purge Script\n");
+            log_info("Admin CMD: Purge Script\n");
             purge_script();
             status = ADMIN_STATUS_OK;
             break;
 
         case I2C_ADMIN_PWD_CMD_FILE_UPLOAD:         // Upload file to filesystem
-            debug_log("Admin CMD: File Upload\n");
+            log_info("Admin CMD: File Upload\n");
             status = file_admin_upload(dir);
             break;
 
         case I2C_ADMIN_PWD_CMD_FILE_DOWNLOAD:       // Download file from filesystem
-            debug_log("Admin CMD: File Download\n");
+            log_info("Admin CMD: File Download\n");
             status = file_admin_download(dir);
             break;
 
         case I2C_ADMIN_PWD_CMD_FILE_DELETE:         // Delete file from filesystem
-            debug_log("Admin CMD: File Delete\n");
+            log_info("Admin CMD: File Delete\n");
             status = file_admin_delete(dir);
             break;
 
         case I2C_ADMIN_PWD_CMD_FILE_DOWNLOAD_NEXT:  // Load next chunk for chunked download
-            debug_log("Admin CMD: File Download Next\n");
+            log_debug("Admin CMD: File Download Next\n");
             status = file_admin_load_chunk();
             break;
 
         default:
-            debug_log("Unknown admin command: pwd=0x%02x, cmd=0x%02x\n", pwd, cmd);
+            log_error("Unknown admin command: pwd=0x%02x, cmd=0x%02x\n", pwd, cmd);
             status = ADMIN_STATUS_INVALID_PACKET;
             break;
     }
@@ -632,264 +654,100 @@ void i2c_process_pending_admin_command(void) {
 
 
 /**
- * Get value from configuration register
+ * Get the time since Raspberry Pi accessed the I2C slave last time
+ *
+ * @return The idle time in microseconds
+ */
+uint32_t i2c_get_idle_time_us(void) {
+    return time_us_32() - last_slave_event_us;
+}
+
+
+// Check if configuration writes are being staged, discard them if not committed in time
+static bool is_conf_txn_open(void) {
+    if (conf_txn_open && time_us_32() - conf_txn_begin_us > CONF_TXN_TIMEOUT_US) {
+        log_warn("Configuration transaction expired, %d staged writes discarded.\n", conf_txn_count);
+        conf_txn_open = false;
+        conf_txn_count = 0;
+    }
+    return conf_txn_open;
+}
+
+
+// Find the staged write of configuration item, return -1 if not staged
+static int find_conf_txn_item(conf_key_t key) {
+    for (int i = 0; i < conf_txn_count; i++) {
+        if (conf_txn_keys[i] == key) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+// Begin staging configuration writes
+static void begin_conf_txn(void) {
+    conf_txn_open = true;
+    conf_txn_begin_us = time_us_32();
+    conf_txn_count = 0;
+}
+
+
+// Apply staged configuration writes at once, or discard them
+static void commit_conf_txn(bool apply) {
+    conf_txn_applied = false;
+    if (is_conf_txn_open() && apply) {
+        conf_txn_applied = conf_set_batch(conf_txn_keys, conf_txn_values, conf_txn_count);
+    }
+    conf_txn_open = false;
+    conf_txn_count = 0;
+}
+
+
+/**
+ * Get value from configuration register, staged value is returned during transaction
  *
  * @param index The index of the register
  * @return The value of the register
  */
 uint8_t get_config_register(uint8_t index) {
-
-    switch (index) {
-        case I2C_CONF_ADDRESS:
-            return conf_get(CONF_ADDRESS);
-
-        case I2C_CONF_DEFAULT_ON_DELAY:
-            return conf_get(CONF_DEFAULT_ON_DELAY);
-        case I2C_CONF_POWER_CUT_DELAY:
-            return conf_get(CONF_POWER_CUT_DELAY);
-
-        case I2C_CONF_PULSE_INTERVAL:
-            return conf_get(CONF_PULSE_INTERVAL);
-        case I2C_CONF_BLINK_LED:
-            return conf_get(CONF_BLINK_LED);
-        case I2C_CONF_DUMMY_LOAD:
-            return conf_get(CONF_DUMMY_LOAD);
-
-        case I2C_CONF_LOW_VOLTAGE:
-            return conf_get(CONF_LOW_VOLTAGE);
-        case I2C_CONF_RECOVERY_VOLTAGE:
-            return conf_get(CONF_RECOVERY_VOLTAGE);
-
-        case I2C_CONF_PS_PRIORITY:
-            return conf_get(CONF_PS_PRIORITY);
-
-        case I2C_CONF_ADJ_VUSB:
-            return conf_get(CONF_ADJ_VUSB);
-        case I2C_CONF_ADJ_VIN:
-            return conf_get(CONF_ADJ_VIN);
-        case I2C_CONF_ADJ_VOUT:
-            return conf_get(CONF_ADJ_VOUT);
-        case I2C_CONF_ADJ_IOUT:
-            return conf_get(CONF_ADJ_IOUT);
-
-        case I2C_CONF_WATCHDOG:
-            return conf_get(CONF_WATCHDOG);
-
-        case I2C_CONF_LOG_TO_FILE:
-            return conf_get(CONF_LOG_TO_FILE);
-
-        case I2C_CONF_BOOTSEL_FTY_RST:
-            return conf_get(CONF_BOOTSEL_FTY_RST);
-
-        case I2C_CONF_ALARM1_SECOND:
-            return conf_get(CONF_ALARM1_SECOND);
-        case I2C_CONF_ALARM1_MINUTE:
-            return conf_get(CONF_ALARM1_MINUTE);
-        case I2C_CONF_ALARM1_HOUR:
-            return conf_get(CONF_ALARM1_HOUR);
-        case I2C_CONF_ALARM1_DAY:
-            return conf_get(CONF_ALARM1_DAY);
-
-        case I2C_CONF_ALARM2_SECOND:
-            return conf_get(CONF_ALARM2_SECOND);
-        case I2C_CONF_ALARM2_MINUTE:
-            return conf_get(CONF_ALARM2_MINUTE);
-        case I2C_CONF_ALARM2_HOUR:
-            return conf_get(CONF_ALARM2_HOUR);
-        case I2C_CONF_ALARM2_DAY:
-            return conf_get(CONF_ALARM2_DAY);
-
-        case I2C_CONF_BELOW_TEMP_ACTION:
-            return conf_get(CONF_BELOW_TEMP_ACTION);
-        case I2C_CONF_BELOW_TEMP_POINT:
-            return conf_get(CONF_BELOW_TEMP_POINT);
-        case I2C_CONF_OVER_TEMP_ACTION:
-            return conf_get(CONF_OVER_TEMP_ACTION);
-        case I2C_CONF_OVER_TEMP_POINT:
-            return conf_get(CONF_OVER_TEMP_POINT);
-
-        case I2C_CONF_DST_OFFSET:
-            return conf_get(CONF_DST_OFFSET);
-        case I2C_CONF_DST_BEGIN_MON:
-            return conf_get(CONF_DST_BEGIN_MON);
-        case I2C_CONF_DST_BEGIN_DAY:
-            return conf_get(CONF_DST_BEGIN_DAY);
-        case I2C_CONF_DST_BEGIN_HOUR:
-            return conf_get(CONF_DST_BEGIN_HOUR);
-        case I2C_CONF_DST_BEGIN_MIN:
-            return conf_get(CONF_DST_BEGIN_MIN);
-        case I2C_CONF_DST_END_MON:
-            return conf_get(CONF_DST_END_MON);
-        case I2C_CONF_DST_END_DAY:
-            return conf_get(CONF_DST_END_DAY);
-        case I2C_CONF_DST_END_HOUR:
-            return conf_get(CONF_DST_END_HOUR);
-        case I2C_CONF_DST_END_MIN:
-            return conf_get(CONF_DST_END_MIN);
-        case I2C_CONF_DST_APPLIED:
-            return conf_get(CONF_DST_APPLIED);
-
-		case I2C_CONF_SYS_CLOCK_MHZ:
-			return conf_get(CONF_SYS_CLOCK_MHZ);
-
-        case I2C_CONF_VIN_HOT_STANDBY:
-            return conf_get(CONF_VIN_HOT_STANDBY);
+    conf_key_t key = conf_get_key_by_register(index);
+    if (key >= CONF_COUNT) {
+        return 0;
     }
-    return 0;
+    if (is_conf_txn_open()) {
+        int i = find_conf_txn_item(key);
+        if (i >= 0) {
+            return conf_txn_values[i];
+        }
+    }
+    return conf_get(key);
 }
 
 
 /**
- * Set value to configuration register
+ * Set value to configuration register, invalid value is ignored
+ * The value is staged if a transaction is begun by I2C_ADMIN_CONF_BEGIN
  *
  * @param index The index of the register
  * @param value The value to set
  */
 void set_config_register(uint8_t index, uint8_t value) {
-
-    switch (index) {
-        case I2C_CONF_ADDRESS:
-            conf_set(CONF_ADDRESS, value);
-            break;
-
-        case I2C_CONF_DEFAULT_ON_DELAY:
-            conf_set(CONF_DEFAULT_ON_DELAY, value);
-			break;
-        case I2C_CONF_POWER_CUT_DELAY:
-            conf_set(CONF_POWER_CUT_DELAY, value);
-			break;
-
-        case I2C_CONF_PULSE_INTERVAL:
-            conf_set(CONF_PULSE_INTERVAL, value);
-			break;
-        case I2C_CONF_BLINK_LED:
-            conf_set(CONF_BLINK_LED, value);
-			break;
-        case I2C_CONF_DUMMY_LOAD:
-            conf_set(CONF_DUMMY_LOAD, value);
-			break;
-
-        case I2C_CONF_LOW_VOLTAGE:
-            conf_set(CONF_LOW_VOLTAGE, value);
-			break;
-        case I2C_CONF_RECOVERY_VOLTAGE:
-            conf_set(CONF_RECOVERY_VOLTAGE, value);
-			break;
-
-	    case I2C_CONF_PS_PRIORITY:
-            if (value == POWER_SOURCE_PRIORITY_VUSB || value == POWER_SOURCE_PRIORITY_VIN) {
-                conf_set(CONF_PS_PRIORITY, value);
-            } else {
-                debug_log("Invalid power source priority ignored: %d\n", value);
-            }
-	        break;
-
-        case I2C_CONF_ADJ_VUSB:
-            conf_set(CONF_ADJ_VUSB, value);
-			break;
-        case I2C_CONF_ADJ_VIN:
-            conf_set(CONF_ADJ_VIN, value);
-			break;
-        case I2C_CONF_ADJ_VOUT:
-            conf_set(CONF_ADJ_VOUT, value);
-			break;
-        case I2C_CONF_ADJ_IOUT:
-            conf_set(CONF_ADJ_IOUT, value);
-			break;
-
-        case I2C_CONF_WATCHDOG:
-            conf_set(CONF_WATCHDOG, value);
-            break;
-
-        case I2C_CONF_LOG_TO_FILE:
-            conf_set(CONF_LOG_TO_FILE, value);
-			break;
-
-        case I2C_CONF_BOOTSEL_FTY_RST:
-            conf_set(CONF_BOOTSEL_FTY_RST, value);
-			break;
-
-        case I2C_CONF_ALARM1_SECOND:
-            conf_set(CONF_ALARM1_SECOND, value);
-			break;
-        case I2C_CONF_ALARM1_MINUTE:
-            conf_set(CONF_ALARM1_MINUTE, value);
-			break;
-        case I2C_CONF_ALARM1_HOUR:
-            conf_set(CONF_ALARM1_HOUR, value);
-			break;
-        case I2C_CONF_ALARM1_DAY:
-            conf_set(CONF_ALARM1_DAY, value);
-			break;
-
-        case I2C_CONF_ALARM2_SECOND:
-            conf_set(CONF_ALARM2_SECOND, value);
-			break;
-        case I2C_CONF_ALARM2_MINUTE:
-            conf_set(CONF_ALARM2_MINUTE, value);
-			break;
-        case I2C_CONF_ALARM2_HOUR:
-            conf_set(CONF_ALARM2_HOUR, value);
-			break;
-        case I2C_CONF_ALARM2_DAY:
-            conf_set(CONF_ALARM2_DAY, value);
-			break;
-
-        case I2C_CONF_BELOW_TEMP_ACTION:
-            conf_set(CONF_BELOW_TEMP_ACTION, value);
-			break;
-        case I2C_CONF_BELOW_TEMP_POINT:
-            conf_set(CONF_BELOW_TEMP_POINT, value);
-			break;
-        case I2C_CONF_OVER_TEMP_ACTION:
-            conf_set(CONF_OVER_TEMP_ACTION, value);
-			break;
-        case I2C_CONF_OVER_TEMP_POINT:
-            conf_set(CONF_OVER_TEMP_POINT, value);
-			break;
-
-        case I2C_CONF_DST_OFFSET:
-            conf_set(CONF_DST_OFFSET, value);
-            break;
-        case I2C_CONF_DST_BEGIN_MON:
-            conf_set(CONF_DST_BEGIN_MON, value);
-            break;
-        case I2C_CONF_DST_BEGIN_DAY:
-            conf_set(CONF_DST_BEGIN_DAY, value);
-            break;
-        case I2C_CONF_DST_BEGIN_HOUR:
-            conf_set(CONF_DST_BEGIN_HOUR, value);
-            break;
-        case I2C_CONF_DST_BEGIN_MIN:
-            conf_set(CONF_DST_BEGIN_MIN, value);
-            break;
-        case I2C_CONF_DST_END_MON:
-            conf_set(CONF_DST_END_MON, value);
-            break;
-        case I2C_CONF_DST_END_DAY:
-            conf_set(CONF_DST_END_DAY, value);
-            break;
-        case I2C_CONF_DST_END_HOUR:
-            conf_set(CONF_DST_END_HOUR, value);
-            break;
-        case I2C_CONF_DST_END_MIN:
-            conf_set(CONF_DST_END_MIN, value);
-            break;
-        case I2C_CONF_DST_APPLIED:
-            conf_set(CONF_DST_APPLIED, value);
-            break;
-
-		case I2C_CONF_SYS_CLOCK_MHZ:
-			conf_set(CONF_SYS_CLOCK_MHZ, value);
-			break;
-
-        case I2C_CONF_VIN_HOT_STANDBY:
-            if (value == 0 || value == 1) {
-                conf_set(CONF_VIN_HOT_STANDBY, value);
-            } else {
-                debug_log("Invalid VIN_HOT_STANDBY ignored: %d\n", value);
-            }
-            break;
+    conf_key_t key = conf_get_key_by_register(index);
+    if (key >= CONF_COUNT) {
+        return;
+    }
+    if (!is_conf_txn_open()) {
+        conf_set(key, value);
+    } else if (!conf_is_valid_value(key, value)) {
+        log_warn("Invalid %s=%d not staged.\n", conf_get_key_name(key), value);
+    } else {
+        int i = find_conf_txn_item(key);
+        if (i < 0) {
+            i = conf_txn_count++;
+            conf_txn_keys[i] = key;
+        }
+        conf_txn_values[i] = value;
     }
 }
 
@@ -950,6 +808,7 @@ uint8_t get_read_only_register(uint8_t index) {
 //
 //-----------------------------------------------------------------------------
 static void i2c_slave_handler(i2c_inst_t *i2c, i2c_slave_event_t event) {
+    last_slave_event_us = time_us_32();
     switch (event) {
     case I2C_SLAVE_RECEIVE: // Master has written some data to this slave device
 
@@ -1003,6 +862,15 @@ static void i2c_slave_handler(i2c_inst_t *i2c, i2c_slave_event_t event) {
 					        request_shutdown(true, ACTION_REASON_EXTERNAL_REBOOT);
 					    }
 						break;
+					case I2C_ADMIN_LOG_TAIL:    // Skip unread log text
+					    log_tail_skip();
+					    break;
+					case I2C_ADMIN_CONF_BEGIN:  // Stage following configuration writes
+					    begin_conf_txn();
+					    break;
+					case I2C_ADMIN_CONF_COMMIT: // Apply or discard staged configuration writes
+					    commit_conf_txn(data == 1);
+					    break;
 					case I2C_ADMIN_DIR:         // Set directory
 					    if (old_value != data) {
     					    download_buffer_index = 0;
@@ -1011,7 +879,7 @@ static void i2c_slave_handler(i2c_inst_t *i2c, i2c_slave_event_t event) {
                             upload_buffer_len = 0;
                             upload_buffer_overflow = false;
                             file_admin_clear_download_state();  // Clear chunked download session
-                            debug_log("Set directory to: %s\n", i2c_get_dir_path(data));
+                            log_debug("Set directory to: %s\n", i2c_get_dir_path(data));
                         }
 					    break;
 					case I2C_ADMIN_UPLOAD:      // Master uploads something
@@ -1050,7 +918,7 @@ static void i2c_slave_handler(i2c_inst_t *i2c, i2c_slave_event_t event) {
 					switch (i2c_index) {
 						case I2C_VREG_TMP112_TEMP_MSB:
 						case I2C_VREG_TMP112_TEMP_LSB:
-							debug_log("Attempt to write temperature register denied.\n");
+							log_warn("Attempt to write temperature register denied.\n");
 							break;
 						case I2C_VREG_TMP112_CONF_MSB:
 						case I2C_VREG_TMP112_TLOW_MSB:
@@ -1091,6 +959,18 @@ static void i2c_slave_handler(i2c_inst_t *i2c, i2c_slave_event_t event) {
 				} else {
 					data = 0x00;
 				}
+		    } else if (i2c_index == I2C_ADMIN_LOG_TAIL) {           // Master tails the log
+		        data = log_tail_read();
+		    } else if (i2c_index == I2C_ADMIN_LOG_TAIL_LEN_MSB) {
+		        uint32_t len = log_tail_available();
+		        data = (uint8_t)(len >> 8);
+		        log_tail_len_lsb = (uint8_t)len;
+		    } else if (i2c_index == I2C_ADMIN_LOG_TAIL_LEN_LSB) {
+		        data = log_tail_len_lsb;
+		    } else if (i2c_index == I2C_ADMIN_CONF_BEGIN) {
+		        data = is_conf_txn_open();
+		    } else if (i2c_index == I2C_ADMIN_CONF_COMMIT) {
+		        data = conf_txn_applied;
 		    } else {                                                // Master reads a admin register
 		        data = i2c_admin_reg[i2c_index - I2C_ADMIN_FIRST];
 		    }
@@ -41,60 +41,7 @@
  */
 #define I2C_CONF_FIRST              16  // ------
  
-#define I2C_CONF_ADDRESS            16  // [0x10] I2C slave address: defaul=0x51
- 
-#define I2C_CONF_DEFAULT_ON_DELAY   17  // [0x11] The delay (in second) between power connection and turning on Pi: default=255(off)
-#define I2C_CONF_POWER_CUT_DELAY    18  // [0x12] The delay (in second) between Pi shutdown and power cut: default=15
- 
-#define I2C_CONF_PULSE_INTERVAL     19  // [0x13] Pulse interval in seconds, for LED and dummy load: default=5
-#define I2C_CONF_BLINK_LED          20  // [0x14] How long the white LED should stay on (in ms), 0 if white LED should not blink.
-#define I2C_CONF_DUMMY_LOAD         21  // [0x15] How long the dummy load should be applied (in ms), 0 if dummy load is off.
- 
-#define I2C_CONF_LOW_VOLTAGE        22  // [0x16] Low voltage threshold (x10), 0=disabled
-#define I2C_CONF_RECOVERY_VOLTAGE   23  // [0x17] Voltage (x10) that triggers recovery, 0=disabled
- 
-#define I2C_CONF_PS_PRIORITY        24  // [0x18] Power source priority, 0=Vusb first, 1=Vin first
- 
-#define I2C_CONF_ADJ_VUSB           25  // [0x19] Adjustment for measured Vusb (x100), range from -127 to 127
-#define I2C_CONF_ADJ_VIN            26  // [0x1A] Adjustment for measured Vin (x100), range from -127 to 127
-#define I2C_CONF_ADJ_VOUT           27  // [0x1B] Adjustment for measured Vout (x100), range from -127 to 127
-#define I2C_CONF_ADJ_IOUT           28  // [0x1C] Adjustment for measured Iout (x1000), range from -127 to 127
- 
-#define I2C_CONF_WATCHDOG           29  // [0x1D] Allowed missing heartbeats before power cycle by watchdog, default=0(disable watchdog)
- 
-#define I2C_CONF_LOG_TO_FILE		30	// [0x1E] Whether to write log into file: 1=allowed, 0=not allowed
- 
-#define I2C_CONF_BOOTSEL_FTY_RST	31	// [0x1F] Whether to allow long press BOOTSEL and then click button for factory reset: 1=allowed, 0=not allowed
- 
-#define I2C_CONF_ALARM1_SECOND      32  // [0x20] Second register for startup alarm (BCD format)
-#define I2C_CONF_ALARM1_MINUTE      33  // [0x21] Minute register for startup alarm (BCD format)
-#define I2C_CONF_ALARM1_HOUR        34  // [0x22] Hour register for startup alarm (BCD format)
-#define I2C_CONF_ALARM1_DAY         35  // [0x23] Day register for startup alarm (BCD format)
- 
-#define I2C_CONF_ALARM2_SECOND      36  // [0x24] Second register for shutdown alarm (BCD format)
-#define I2C_CONF_ALARM2_MINUTE      37  // [0x25] Minute register for shutdown alarm (BCD format)
-#define I2C_CONF_ALARM2_HOUR        38  // [0x26] Hour register for shutdown alarm (BCD format)
-#define I2C_CONF_ALARM2_DAY         39  // [0x27] Day register for shutdown alarm (BCD format)
- 
-#define I2C_CONF_BELOW_TEMP_ACTION  40  // [0x28] Action for below temperature: 0-do nothing; 1-startup; 2-shutdown
-#define I2C_CONF_BELOW_TEMP_POINT   41  // [0x29] Set point for below temperature (signed degrees of Celsius)
-#define I2C_CONF_OVER_TEMP_ACTION   42  // [0x2A] Action for over temperature: 0-do nothing; 1-startup; 2-shutdown
-#define I2C_CONF_OVER_TEMP_POINT    43  // [0x2B] Set point for over temperature (signed degrees of Celsius)
- 
-#define I2C_CONF_DST_OFFSET         44  // [0x2C] b7=mode; b6~b0: DST offset in minute, default=0(disable DST)
-#define I2C_CONF_DST_BEGIN_MON      45  // [0x2D] DST begin month in BCD format
-#define I2C_CONF_DST_BEGIN_DAY      46  // [0x2E] mode=0: b7~b4=week in BCD, b3~b0=day in BCD; mode=1: b7~b0=date in BCD
-#define I2C_CONF_DST_BEGIN_HOUR     47  // [0x2F] DST begin hour in BCD format
-#define I2C_CONF_DST_BEGIN_MIN      48  // [0x30] DST begin minute in BCD format
-#define I2C_CONF_DST_END_MON        49  // [0x31] DST end month in BCD format
-#define I2C_CONF_DST_END_DAY        50  // [0x32] mode=0: b7~b4=week in BCD, b3~b0=day in BCD; mode=1: b7~b0=date in BCD
-#define I2C_CONF_DST_END_HOUR       51  // [0x33] DST end hour in BCD format
-#define I2C_CONF_DST_END_MIN        52  // [0x34] DST end minute in BCD format
-#define I2C_CONF_DST_APPLIED        53  // [0x35] Whether DST has been applied
- 
-#define I2C_CONF_SYS_CLOCK_MHZ		54	// [0x36] System clock (in MHz) for RP2350: default=48 (required for USB drive and USB-uart)
-
-#define I2C_CONF_VIN_HOT_STANDBY    55  // [0x37] Keep VIN DC/DC enabled in VUSB-first mode, 0=off, 1=on
+// Registers of configuration items are defined in conf_items.h
 
 #define I2C_CONF_LAST               63  // ------
 #define I2C_ADMIN_FIRST             64  // ------
@@ -111,6 +58,13 @@
  
 #define I2C_ADMIN_SHUTDOWN          71  // [0x47] Register for shutdown request
 
+#define I2C_ADMIN_LOG_TAIL          72  // [0x48] Stream of log text (0x00 if nothing to read), write any value to skip unread text
+#define I2C_ADMIN_LOG_TAIL_LEN_MSB  73  // [0x49] Most significant byte of unread log text length (read it before LSB)
+#define I2C_ADMIN_LOG_TAIL_LEN_LSB  74  // [0x4A] Least significant byte of unread log text length
+
+#define I2C_ADMIN_CONF_BEGIN        75  // [0x4B] Write any value to stage following configuration writes till commit, read 1 if staging
+#define I2C_ADMIN_CONF_COMMIT       76  // [0x4C] Write 1 to apply staged configuration writes at once, 0 to discard them, read 1 if last commit was applied
+
 #define I2C_ADMIN_LAST              79  // ------
 
 
@@ -153,6 +107,7 @@
  * When writing it via I2C, make sure to write password byte first
  */
 #define I2C_ADMIN_PWD_CMD_PRINT_PRODUCT_INFO        0x17F0
+#define I2C_ADMIN_PWD_CMD_PRINT_FLASH_STATS         0x18F2
 #define I2C_ADMIN_PWD_CMD_FORMAT_DISK               0x37FD
 #define I2C_ADMIN_PWD_CMD_RESET_RTC                 0x387C
 #define I2C_ADMIN_PWD_CMD_ENABLE_ID_EEPROM_WP       0x81EE
@@ -218,6 +173,14 @@ void i2c_devices_init(void);
 void i2c_process_pending_admin_command(void);
 
 
+/**
+ * Get the time since Raspberry Pi accessed the I2C slave last time
+ *
+ * @return The idle time in microseconds
+ */
+uint32_t i2c_get_idle_time_us(void);
+
+
 /**
  * Read data from slave device connected to internal I2C bus
  * 
@@ -252,7 +215,7 @@ uint8_t get_read_only_register(uint8_t index);
 
 
 /**
- * Get value from configuration register
+ * Get value from configuration register, staged value is returned during transaction
  * 
  * @param index The index of the register
  * @return The value of the register
@@ -261,7 +224,8 @@ uint8_t get_config_register(uint8_t index);
 
 
 /**
- * Set value to configuration register
+ * Set value to configuration register, invalid value is ignored
+ * The value is staged if a transaction is begun by I2C_ADMIN_CONF_BEGIN
  * 
  * @param index The index of the register
  * @param value The value to set
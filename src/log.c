@@ -9,34 +9,188 @@
 #include <stdarg.h>
 
 #include "log.h"
+#include "log_format.h"
+#include "log_time.h"
 #include "conf.h"
+#include "fatfs_disk.h"
 #include "main.h"
 #include "rtc.h"
+#include "util.h"
+#include "lz.h"
+#include "i2c.h"
+
+
+#define LOG_MODULE          "log"
 
 
 #define MAX_MESSAGE_SIZE    256
 #define BUFFER_SIZE         8192
 #define BUFFER_MASK         (BUFFER_SIZE - 1)
 
+#define TEXT_BUFFER_SIZE    8192
+#define TEXT_BUFFER_MASK    (TEXT_BUFFER_SIZE - 1)
+
+#define BIN_BUFFER_SIZE     8192
+#define BIN_BUFFER_MASK     (BIN_BUFFER_SIZE - 1)
+
 #define TIME_HEADER_SIZE    21  // [MM-DD HH:mm:ss.SSS]
 
 #define LOG_FILE_PATH       "/log/WittyPi5.log"
+#define LOG_BIN_FILE_PATH   "/log/WittyPi5.wlg"
+
+#define LOG_FILE_FORMAT_TEXT    0
+#define LOG_FILE_FORMAT_BINARY  1
+
+#define LOG_FILE_GENERATIONS    3       // Current log file and the rotated ones
+#define LOG_FILE_SIZE_UNIT      65536   // Unit of CONF_LOG_FILE_SIZE
+
+#define LOG_MAX_BIN_EVENT_SIZE  (MAX_MESSAGE_SIZE + 32)
 
 #define SUPPRESS_LOG_FILE_SAVING_US    5000000
 
+#define LOG_COMPRESS_I2C_IDLE_US    50000   // Only compress if I2C is idle for 50ms
+
+#define PERSIST_BUFFER_SIZE 4096
+#define PERSIST_BUFFER_MASK (PERSIST_BUFFER_SIZE - 1)
+#define PERSIST_MAGIC       0x574C5031  // "WLP1"
+#define PERSIST_ENTRY_HEADER_SIZE   12  // Length, check value and timestamp
+#define PERSIST_MAX_DEFERRED    (PERSIST_BUFFER_SIZE / 2)   // Unsaved log allowed when saving is deferred
+#define PERSIST_ALIGN       8192    // Persistent log never crosses a boundary of this size, e.g. between SRAM banks
+
+#define TAIL_MAX_AVAILABLE  (TEXT_BUFFER_SIZE - MAX_MESSAGE_SIZE)   // Older text may be overwritten by next message
+
+#define LOG_DEFERRED_FORMATTING 1       // Format messages in main loop instead of the caller's context
 
+#define LOG_MAX_DEFERRED_ARGS   8       // Messages with more arguments are formatted immediately
+#define LOG_MAX_SPEC_LENGTH     16
+
+#define LOG_RECORD_COMMITTED    0x01    // Record is completely written by producer
+#define LOG_RECORD_PADDING      0x02    // Unused space till the end of buffer
+
+#define LOG_RECORD_TEXT         0       // Timestamp and formatted message
+#define LOG_RECORD_DEFERRED     1       // Timestamp, format string pointer and raw arguments
+
+#define LOG_RECORD_SIZE(len)    ((sizeof(log_record_t) + (len) + 3) & ~3u)
+
+
+// Record in the ring buffer, always contiguous and 4-byte aligned
+typedef struct {
+    uint16_t len;               // Length of data
+    volatile uint8_t flags;
+    uint8_t type;
+    char data[];
+} log_record_t;
+
+
+// Ring buffer of records, written by any context (main loop, IRQ, alarm callback) and read by main loop
 typedef struct {
     volatile uint32_t write_idx;
     volatile uint32_t read_idx;
-    volatile uint32_t file_idx;
-    char buffer[BUFFER_SIZE];
+    uint32_t buffer[BUFFER_SIZE / 4];
 } log_buffer_t;
 
+
+// Text of the committed records, waiting for printing and saving to file (and reading by I2C log tail)
+typedef struct {
+    volatile uint32_t write_idx;
+    uint32_t print_idx;
+    uint32_t file_idx;
+    char buffer[TEXT_BUFFER_SIZE];
+} log_text_t;
+
+
+// Encoded events waiting for saving to binary log file
+typedef struct {
+    uint32_t write_idx;
+    uint32_t file_idx;
+    int64_t last_timestamp;     // Time of the last encoded event
+    bool time_valid;            // Whether the next event can be encoded as delta
+    int64_t pending_timestamp;  // Time that the first pending event refers to
+    uint8_t buffer[BIN_BUFFER_SIZE];
+} log_bin_t;
+
+// Copy of recent messages in RAM that is not initialized at boot, so the ones not saved to file survive reset.
+// Entry: 2-byte length of text, 2-byte check value, 8-byte timestamp, then the text without time header
+typedef struct {
+    uint32_t magic;
+    uint32_t first_idx;         // Start of the oldest entry
+    uint32_t file_idx;          // Start of the first entry not saved to file yet
+    uint32_t write_idx;
+    uint32_t crc;               // CRC-32 of the fields above
+    uint8_t buffer[PERSIST_BUFFER_SIZE];
+} log_persist_t;
+
+// Only one SRAM power domain is kept on during hibernation, the one holding the start of persistent log
+_Static_assert(sizeof(log_persist_t) <= PERSIST_ALIGN && (SRAM4_BASE - SRAM_BASE) % PERSIST_ALIGN == 0,
+               "persistent log may cross SRAM banks");
+
 static log_buffer_t log_buffer = {0};
 
+static log_text_t log_text = {0};
+
+static log_bin_t log_bin = {0};
+
+static log_persist_t __uninitialized_ram(log_persist) __attribute__((aligned(PERSIST_ALIGN)));
+
+static bool persist_restored = false;
+
+static uint8_t file_format = LOG_FILE_FORMAT_TEXT;
+
+// Log files of each format, from the current one to the oldest one (8.3 names)
+static const char *const log_file_paths[2][LOG_FILE_GENERATIONS] = {
+    {LOG_FILE_PATH, "/log/WittyPi5.1", "/log/WittyPi5.2"},
+    {LOG_BIN_FILE_PATH, "/log/WittyPi5.w1", "/log/WittyPi5.w2"},
+};
+
+// Compressed rotated log files, with the same generation numbers as log_file_paths (8.3 names)
+static const char *const log_archive_paths[2][LOG_FILE_GENERATIONS] = {
+    {NULL, "/log/WP5Log1.lz", "/log/WP5Log2.lz"},
+    {NULL, "/log/WP5Wlg1.lz", "/log/WP5Wlg2.lz"},
+};
+
+// Current log file is kept open between savings, so the end of file is only searched when opening
+static FIL log_file = {0};
+static bool log_file_open = false;
+static uint8_t log_file_format = LOG_FILE_FORMAT_TEXT;
+static uint32_t log_file_host_writes = 0;
+
+// Rotated log file being compressed in idle time
+static lz_encoder_t lz_encoder;
+static FIL compress_src = {0};
+static FIL compress_dst = {0};
+static bool compressing = false;
+static bool compress_pending = true;    // Rotated files may need compression (checked at boot and after rotating)
+static uint8_t compress_format = 0;
+static uint8_t compress_generation = 0;
+
+static log_stats_t stats = {0};
+
+static uint32_t reported_drops = 0;
+
+static volatile uint8_t log_level = LOG_LEVEL_DEBUG;
+
+static volatile uint32_t tail_idx = 0;
+
+static log_day_t log_day = {0};
+
 extern FATFS filesystem;
 
 
+// Apply the new runtime log level
+static void on_log_level_conf_changed(conf_key_t key, uint8_t old_val, uint8_t new_val) {
+    log_level = new_val;
+}
+
+
+/**
+ * Initialize the runtime log level from configuration
+ */
+void log_init(void) {
+    log_level = conf_get(CONF_LOG_LEVEL);
+    conf_subscribe(CONF_LOG_LEVEL, CONF_LOG_LEVEL, on_log_level_conf_changed);
+}
+
+
 /**
  * Check whether the log should be saved to file
  * 
@@ -57,59 +211,535 @@ void log_save_to_file(bool s2f) {
 }
 
 
+// Format timestamp for time header, the calendar date is only calculated when the day changes
 static void ms_timestamp_to_str(int64_t ms_timestamp, char *buf) {
-    int32_t millisec = ms_timestamp % 1000;
-    DateTime dt;
-    timestamp_to_datetime(ms_timestamp / 1000 - TIMESTAMP_2000_01_01, &dt);
-	sprintf(buf, "%02d-%02d %02d:%02d:%02d.%03d", dt.month, dt.day, dt.hour, dt.min, dt.sec, millisec);
+    log_format_time(&log_day, ms_timestamp, buf);
 }
 
 
-bool log_write(const char* data, size_t len) {
+// Reserve space for a record, interrupts are disabled only for claiming the space
+static log_record_t *reserve_record(uint8_t type, uint32_t len) {
+    uint32_t size = LOG_RECORD_SIZE(len);
+    uint32_t status = save_and_disable_interrupts();
     uint32_t write_idx = log_buffer.write_idx;
-    uint32_t read_idx = log_buffer.read_idx;
-
-    if (((write_idx - read_idx) + len) >= BUFFER_SIZE) {
-        return false;   // Message is too long
+    uint32_t padding = BUFFER_SIZE - (write_idx & BUFFER_MASK);
+    if (padding >= size) {
+        padding = 0;
     }
-
-    for (size_t i = 0; i < len; i++) {
-        log_buffer.buffer[(write_idx + i) & BUFFER_MASK] = data[i];
+    if (write_idx + padding + size - log_buffer.read_idx > BUFFER_SIZE) {
+        stats.dropped_records++;
+        stats.dropped_bytes += len;
+        restore_interrupts(status);
+        return NULL;
+    }
+    if (padding) {
+        log_record_t *pad = (log_record_t *)((uint8_t *)log_buffer.buffer + (write_idx & BUFFER_MASK));
+        pad->len = padding - sizeof(log_record_t);
+        pad->flags = LOG_RECORD_PADDING | LOG_RECORD_COMMITTED;
+        write_idx += padding;
     }
+    log_record_t *record = (log_record_t *)((uint8_t *)log_buffer.buffer + (write_idx & BUFFER_MASK));
+    record->len = len;
+    record->flags = 0;
+    record->type = type;
+    __dmb();
+    log_buffer.write_idx = write_idx + size;
+    restore_interrupts(status);
+    return record;
+}
 
+
+// Mark the record as completely written, so consumer can take it
+static void commit_record(log_record_t *record) {
     __dmb();
+    record->flags = LOG_RECORD_COMMITTED;
+}
 
-    log_buffer.write_idx = write_idx + len;
 
+// Write one record into ring buffer
+static bool write_record(uint8_t type, const void *data, size_t len) {
+    log_record_t *record = reserve_record(type, len);
+    if (!record) {
+        return false;
+    }
+    memcpy(record->data, data, len);
+    commit_record(record);
     return true;
 }
 
 
+// Write a formatted message with timestamp
+static bool write_text(int64_t timestamp, const char *text, size_t len) {
+    char data[sizeof(timestamp) + MAX_MESSAGE_SIZE];
+    if (len > MAX_MESSAGE_SIZE) {
+        len = MAX_MESSAGE_SIZE;
+    }
+    memcpy(data, &timestamp, sizeof(timestamp));
+    memcpy(data + sizeof(timestamp), text, len);
+    return write_record(LOG_RECORD_TEXT, data, sizeof(timestamp) + len);
+}
+
+
 /**
- * Submit a log message
+ * Write a message into log buffer as one record, can be called from any context
  * 
- * @param fmt The printf format of the message
+ * @param data The message text, the time header will be added
+ * @param len The length of message
+ * @return true if written, false if the buffer is full
  */
-void debug_log(const char* format, ...) {
+bool log_write(const char* data, size_t len) {
+    return write_text(powman_timer_get_ms(), data, len);
+}
+
+
+// Save timestamp, format pointer and arguments as a record, strings are copied, return false if not possible
+static bool write_deferred(int64_t timestamp, const char *format, va_list args) {
+    uint8_t data[MAX_MESSAGE_SIZE];
+    uint32_t pos = 0;
+    memcpy(data + pos, &timestamp, sizeof(timestamp));
+    pos += sizeof(timestamp);
+    memcpy(data + pos, &format, sizeof(format));
+    pos += sizeof(format);
+
+    int count = 0;
+    for (const char *p = format; *p; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        log_arg_t arg;
+        bool is_signed;
+        p = log_parse_spec(p + 1, &arg, &is_signed);
+        if (arg == LOG_ARG_NONE) {
+            continue;
+        }
+        if (arg == LOG_ARG_UNSUPPORTED || ++count > LOG_MAX_DEFERRED_ARGS) {
+            return false;
+        }
+        if (arg == LOG_ARG_STRING) {
+            const char *str = va_arg(args, const char *);
+            if (!str) {
+                str = "(null)";
+            }
+            size_t len = strlen(str) + 1;
+            if (pos + len > sizeof(data)) {
+                return false;
+            }
+            memcpy(data + pos, str, len);
+            pos += len;
+        } else if (arg == LOG_ARG_LONG_LONG) {
+            uint64_t v = va_arg(args, unsigned long long);
+            if (pos + sizeof(v) > sizeof(data)) {
+                return false;
+            }
+            memcpy(data + pos, &v, sizeof(v));
+            pos += sizeof(v);
+        } else {
+            uint32_t v;
+            if (arg == LOG_ARG_LONG) {
+                v = va_arg(args, unsigned long);
+            } else if (arg == LOG_ARG_SIZE) {
+                v = va_arg(args, size_t);
+            } else {
+                v = va_arg(args, unsigned int);
+            }
+            if (pos + sizeof(v) > sizeof(data)) {
+                return false;
+            }
+            memcpy(data + pos, &v, sizeof(v));
+            pos += sizeof(v);
+        }
+    }
+    write_record(LOG_RECORD_DEFERRED, data, pos);
+    return true;
+}
+
+
+// Get timestamp of a record
+static int64_t get_record_timestamp(const log_record_t *record) {
+    int64_t timestamp;
+    memcpy(&timestamp, record->data, sizeof(timestamp));
+    return timestamp;
+}
+
+
+// Get format string of a deferred record, and the pointer to its arguments
+static const char *get_record_format(const log_record_t *record, const uint8_t **args) {
+    const char *format;
+    memcpy(&format, record->data + sizeof(int64_t), sizeof(format));
+    *args = (const uint8_t *)record->data + sizeof(int64_t) + sizeof(format);
+    return format;
+}
+
+
+// Format a record into text with time header, return the length of text
+static int format_record(const log_record_t *record, char *buf, int size) {
+    buf[0] = '[';
+    ms_timestamp_to_str(get_record_timestamp(record), buf + 1);
+    buf[19] = ']';
+    buf[20] = ' ';
+    int pos = TIME_HEADER_SIZE;
+
+    if (record->type == LOG_RECORD_TEXT) {
+        int len = record->len - sizeof(int64_t);
+        if (len > size - 1 - pos) {
+            len = size - 1 - pos;
+        }
+        memcpy(buf + pos, record->data + sizeof(int64_t), len);
+        pos += len;
+        buf[pos] = '\0';
+        return pos;
+    }
+
+    const uint8_t *data;
+    const char *format = get_record_format(record, &data);
+    const uint8_t *end = (const uint8_t *)record->data + record->len;
+
+    const char *p = format;
+    while (*p && pos < size - 1) {
+        if (*p != '%') {
+            buf[pos++] = *p++;
+            continue;
+        }
+        log_arg_t arg;
+        bool is_signed;
+        const char *conv = log_parse_spec(p + 1, &arg, &is_signed);
+        if (arg == LOG_ARG_NONE) {
+            buf[pos++] = '%';
+            p = conv + 1;
+            continue;
+        }
+
+        // Rebuild the specification without l/z length modifier (values are stored as 32 bits), except for long long
+        char spec[LOG_MAX_SPEC_LENGTH];
+        int spec_len = 0;
+        for (const char *q = p; q < conv && spec_len < LOG_MAX_SPEC_LENGTH - 4; q++) {
+            if (*q != 'l' && *q != 'z') {
+                spec[spec_len++] = *q;
+            }
+        }
+        if (arg == LOG_ARG_LONG_LONG) {
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+        }
+        spec[spec_len++] = *conv;
+        spec[spec_len] = '\0';
+
+        int n;
+        if (arg == LOG_ARG_STRING) {
+            n = snprintf(buf + pos, size - pos, spec, (const char *)data);
+            data += strlen((const char *)data) + 1;
+        } else if (arg == LOG_ARG_LONG_LONG) {
+            uint64_t v;
+            memcpy(&v, data, sizeof(v));
+            data += sizeof(v);
+            n = snprintf(buf + pos, size - pos, spec, (unsigned long long)v);
+        } else {
+            uint32_t v;
+            memcpy(&v, data, sizeof(v));
+            data += sizeof(v);
+            n = snprintf(buf + pos, size - pos, spec, (unsigned int)v);
+        }
+        if (data > end || n < 0) {
+            break;
+        }
+        pos += n;
+        if (pos > size - 1) {
+            pos = size - 1;
+        }
+        p = conv + 1;
+    }
+    buf[pos] = '\0';
+    return pos;
+}
+
+
+// Write a message as deferred record if possible, otherwise format it now
+static void submit_message(const char *format, va_list args) {
     char local_buffer[MAX_MESSAGE_SIZE + 1];
-	char time_str[TIME_HEADER_SIZE];
 
     int64_t timestamp = powman_timer_get_ms();
-    ms_timestamp_to_str(timestamp, time_str + 1);
-    time_str[0] = '[';
-    time_str[19] = ']';
-    time_str[20] = ' ';
-	memcpy(local_buffer, time_str, TIME_HEADER_SIZE);
 
+#if LOG_DEFERRED_FORMATTING
+    va_list deferred_args;
+    va_copy(deferred_args, args);
+    bool deferred = write_deferred(timestamp, format, deferred_args);
+    va_end(deferred_args);
+    if (deferred) {
+        return;
+    }
+#endif
+
+    int len = vsnprintf(local_buffer, sizeof(local_buffer) - TIME_HEADER_SIZE, format, args);
+    if (len > 0) {
+        if (len > MAX_MESSAGE_SIZE - TIME_HEADER_SIZE) {
+            len = MAX_MESSAGE_SIZE - TIME_HEADER_SIZE;  // Message is truncated
+        }
+        write_text(timestamp, local_buffer, len);
+    }
+}
+
+
+/**
+ * Submit a log message without level (never filtered), it is formatted later in main loop when possible
+ * 
+ * @param fmt The printf format of the message, must be a string literal
+ */
+void debug_log(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    submit_message(format, args);
+    va_end(args);
+}
+
+
+/**
+ * Submit a log message with severity level, it is dropped if the level is below the runtime log level
+ * 
+ * @param level The severity level (LOG_LEVEL_???)
+ * @param fmt The printf format of the message, must be a string literal
+ */
+void log_message(uint8_t level, const char* format, ...) {
+    if (level < log_level) {
+        return;
+    }
     va_list args;
     va_start(args, format);
-    int len = vsnprintf(local_buffer + TIME_HEADER_SIZE, sizeof(local_buffer) - TIME_HEADER_SIZE, format, args);
+    submit_message(format, args);
     va_end(args);
+}
 
-    if (len > 0) {
-		int total_len = TIME_HEADER_SIZE + len;
-        log_write(local_buffer, total_len);
+
+// Append text, the oldest text not saved to file yet will be overwritten if there is no space
+static void text_append(const char *data, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        log_text.buffer[(log_text.write_idx + i) & TEXT_BUFFER_MASK] = data[i];
+    }
+    __dmb();    // Text is written before I2C log tail can see it
+    log_text.write_idx += len;
+    if (log_text.write_idx - log_text.file_idx > TEXT_BUFFER_SIZE) {
+        log_text.file_idx = log_text.write_idx - TEXT_BUFFER_SIZE;
+    }
+    if (log_text.write_idx - log_text.print_idx > TEXT_BUFFER_SIZE) {
+        log_text.print_idx = log_text.write_idx - TEXT_BUFFER_SIZE;
+    }
+}
+
+
+// Encode a record as binary event, return the length of event
+static int encode_record(const log_record_t *record, uint8_t *buf) {
+    int64_t timestamp = get_record_timestamp(record);
+    int pos = 0;
+    if (!log_bin.time_valid || timestamp < log_bin.last_timestamp) {
+        buf[pos++] = LOG_BIN_TIME;
+        for (int i = 0; i < 8; i++) {
+            buf[pos++] = (uint8_t)(timestamp >> (8 * i));
+        }
+        log_bin.last_timestamp = timestamp;
+        log_bin.time_valid = true;
+    }
+    uint64_t delta = timestamp - log_bin.last_timestamp;
+    log_bin.last_timestamp = timestamp;
+
+    if (record->type == LOG_RECORD_TEXT) {
+        uint32_t len = record->len - sizeof(int64_t);
+        pos += log_put_varint(buf + pos, (delta << LOG_BIN_KIND_BITS) | LOG_BIN_TEXT);
+        pos += log_put_varint(buf + pos, len);
+        memcpy(buf + pos, record->data + sizeof(int64_t), len);
+        return pos + len;
+    }
+
+    const uint8_t *data;
+    const char *format = get_record_format(record, &data);
+    uint32_t id = log_format_id(format);
+    pos += log_put_varint(buf + pos, (delta << LOG_BIN_KIND_BITS) | LOG_BIN_MESSAGE);
+    for (int i = 0; i < LOG_BIN_ID_SIZE; i++) {
+        buf[pos++] = (uint8_t)(id >> (8 * i));
     }
+    for (const char *p = format; *p; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        log_arg_t arg;
+        bool is_signed;
+        p = log_parse_spec(p + 1, &arg, &is_signed);
+        if (arg == LOG_ARG_STRING) {
+            size_t len = strlen((const char *)data) + 1;
+            memcpy(buf + pos, data, len);
+            data += len;
+            pos += len;
+        } else if (arg == LOG_ARG_LONG_LONG) {
+            uint64_t v;
+            memcpy(&v, data, sizeof(v));
+            data += sizeof(v);
+            pos += log_put_varint(buf + pos, is_signed ? (v << 1) ^ (uint64_t)((int64_t)v >> 63) : v);
+        } else if (arg != LOG_ARG_NONE) {
+            uint32_t v;
+            memcpy(&v, data, sizeof(v));
+            data += sizeof(v);
+            pos += log_put_varint(buf + pos, is_signed ? (uint32_t)((v << 1) ^ (uint32_t)((int32_t)v >> 31)) : v);
+        }
+    }
+    return pos;
+}
+
+
+// Append a record to binary buffer, all pending events are dropped if there is no space
+static void bin_append(const log_record_t *record) {
+    uint8_t event[LOG_MAX_BIN_EVENT_SIZE];
+    if (log_bin.file_idx == log_bin.write_idx) {
+        log_bin.pending_timestamp = log_bin.last_timestamp;
+    }
+    int len = encode_record(record, event);
+    if (log_bin.write_idx - log_bin.file_idx + len > BIN_BUFFER_SIZE) {
+        stats.dropped_file_bytes += log_bin.write_idx - log_bin.file_idx;
+        log_bin.file_idx = log_bin.write_idx;
+        log_bin.time_valid = false;
+        log_bin.pending_timestamp = log_bin.last_timestamp;
+        len = encode_record(record, event);
+    }
+    for (int i = 0; i < len; i++) {
+        log_bin.buffer[(log_bin.write_idx + i) & BIN_BUFFER_MASK] = event[i];
+    }
+    log_bin.write_idx += len;
+}
+
+
+// Update the CRC after changing persistent log header
+static void persist_seal(void) {
+    log_persist.crc = crc32((const uint8_t *)&log_persist, offsetof(log_persist_t, crc));
+}
+
+
+// Check whether persistent log header is valid (it is random after power on)
+static bool persist_is_valid(void) {
+    uint32_t used = log_persist.write_idx - log_persist.first_idx;
+    return log_persist.magic == PERSIST_MAGIC
+        && log_persist.crc == crc32((const uint8_t *)&log_persist, offsetof(log_persist_t, crc))
+        && used <= PERSIST_BUFFER_SIZE
+        && log_persist.file_idx - log_persist.first_idx <= used;
+}
+
+
+// Copy data out of persistent log buffer
+static void persist_read(uint32_t idx, uint8_t *data, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        data[i] = log_persist.buffer[(idx + i) & PERSIST_BUFFER_MASK];
+    }
+}
+
+
+// Append a message to persistent log, the oldest entries are overwritten if there is no space
+static void persist_append(int64_t timestamp, const char *text, uint32_t len) {
+    uint8_t entry[PERSIST_ENTRY_HEADER_SIZE + MAX_MESSAGE_SIZE];
+    uint16_t len16 = len;
+    memcpy(entry + 4, &timestamp, sizeof(timestamp));
+    memcpy(entry + PERSIST_ENTRY_HEADER_SIZE, text, len);
+    uint16_t check = crc32(entry + 4, sizeof(timestamp) + len);
+    memcpy(entry, &len16, sizeof(len16));
+    memcpy(entry + 2, &check, sizeof(check));
+
+    uint32_t size = PERSIST_ENTRY_HEADER_SIZE + len;
+    while (log_persist.write_idx + size - log_persist.first_idx > PERSIST_BUFFER_SIZE) {
+        uint16_t old_len;
+        persist_read(log_persist.first_idx, (uint8_t *)&old_len, sizeof(old_len));
+        log_persist.first_idx += PERSIST_ENTRY_HEADER_SIZE + old_len;
+    }
+    if ((int32_t)(log_persist.file_idx - log_persist.first_idx) < 0) {
+        log_persist.file_idx = log_persist.first_idx;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        log_persist.buffer[(log_persist.write_idx + i) & PERSIST_BUFFER_MASK] = entry[i];
+    }
+    log_persist.write_idx += size;
+    persist_seal();
+}
+
+
+// Mark everything in persistent log as saved to file
+static void persist_mark_saved(void) {
+    if (persist_restored && log_persist.file_idx != log_persist.write_idx) {
+        log_persist.file_idx = log_persist.write_idx;
+        persist_seal();
+    }
+}
+
+
+// Submit the messages that previous run did not save to file, they are kept in persistent log again when drained
+static void persist_restore(void) {
+    persist_restored = true;
+    if (!persist_is_valid()) {
+        log_persist.magic = PERSIST_MAGIC;
+        log_persist.first_idx = 0;
+        log_persist.file_idx = 0;
+        log_persist.write_idx = 0;
+        persist_seal();
+        return;
+    }
+    uint32_t idx = log_persist.file_idx;
+    uint32_t write_idx = log_persist.write_idx;
+    if (idx != write_idx) {
+        printf("Restoring %u bytes of log from previous run\n", write_idx - idx);
+    }
+    uint8_t entry[PERSIST_ENTRY_HEADER_SIZE + MAX_MESSAGE_SIZE];
+    while (write_idx - idx >= PERSIST_ENTRY_HEADER_SIZE) {
+        uint16_t len, check;
+        int64_t timestamp;
+        persist_read(idx, entry, PERSIST_ENTRY_HEADER_SIZE);
+        memcpy(&len, entry, sizeof(len));
+        memcpy(&check, entry + 2, sizeof(check));
+        if (len > MAX_MESSAGE_SIZE || write_idx - idx < PERSIST_ENTRY_HEADER_SIZE + len) {
+            break;
+        }
+        persist_read(idx + PERSIST_ENTRY_HEADER_SIZE, entry + PERSIST_ENTRY_HEADER_SIZE, len);
+        if (check != (uint16_t)crc32(entry + 4, sizeof(timestamp) + len)) {
+            break;
+        }
+        memcpy(&timestamp, entry + 4, sizeof(timestamp));
+        write_text(timestamp, (const char *)entry + PERSIST_ENTRY_HEADER_SIZE, len);
+        idx += PERSIST_ENTRY_HEADER_SIZE + len;
+    }
+    log_persist.file_idx = write_idx;
+    persist_seal();
+}
+
+
+/**
+ * Queue the messages that previous run did not save to file
+ *
+ * It should be called at boot before anything is logged, so they are saved before the
+ * messages of this run. Otherwise it is done when the log is processed the first time.
+ */
+void log_restore_persistent(void) {
+    if (!persist_restored) {
+        persist_restore();
+    }
+}
+
+
+// Move committed records into text buffer, stop at the first record that is still being written
+static void drain_records(void) {
+    log_restore_persistent();
+    uint32_t read_idx = log_buffer.read_idx;
+    while (read_idx != log_buffer.write_idx) {
+        log_record_t *record = (log_record_t *)((uint8_t *)log_buffer.buffer + (read_idx & BUFFER_MASK));
+        uint8_t flags = record->flags;
+        if (!(flags & LOG_RECORD_COMMITTED)) {
+            break;
+        }
+        __dmb();
+        if (!(flags & LOG_RECORD_PADDING)) {
+            char text[MAX_MESSAGE_SIZE + 1];
+            int len = format_record(record, text, sizeof(text));
+            text_append(text, len);
+            persist_append(get_record_timestamp(record), text + TIME_HEADER_SIZE, len - TIME_HEADER_SIZE);
+            if (file_format == LOG_FILE_FORMAT_BINARY) {
+                bin_append(record);
+            }
+        }
+        read_idx += LOG_RECORD_SIZE(record->len);
+    }
+    __dmb();
+    log_buffer.read_idx = read_idx;
 }
 
 
@@ -117,28 +747,233 @@ void debug_log(const char* format, ...) {
  * Print logs to serial port, save logs to file if needed
  */
 void process_log_task(void) {
-    
-    uint32_t read_idx = log_buffer.read_idx;
-    uint32_t write_idx = log_buffer.write_idx;
-    
+
+    // Save pending logs in previous format before switching
+    uint8_t format = conf_get(CONF_LOG_FORMAT) ? LOG_FILE_FORMAT_BINARY : LOG_FILE_FORMAT_TEXT;
+    if (format != file_format) {
+        if (is_log_saving_to_file() && !is_usb_msc_device_mounted()) {
+            save_logs_to_file();
+        }
+        file_format = format;
+        log_text.file_idx = log_text.write_idx;
+        log_bin.file_idx = log_bin.write_idx;
+        log_bin.time_valid = false;
+        persist_mark_saved();
+    }
+
+    log_print_pending();
+
+    // save to file
+    bool nearly_full = (file_format == LOG_FILE_FORMAT_BINARY)
+        ? log_bin.write_idx - log_bin.file_idx > BIN_BUFFER_SIZE - LOG_MAX_BIN_EVENT_SIZE
+        : log_text.write_idx - log_text.file_idx > TEXT_BUFFER_SIZE - MAX_MESSAGE_SIZE;
+    if (is_log_saving_to_file() && get_absolute_time() >= SUPPRESS_LOG_FILE_SAVING_US && (!is_usb_msc_device_mounted() || nearly_full)) {
+        save_logs_to_file();
+    }
+}
+
+
+/**
+ * Print logs to serial port without saving them to file
+ *
+ * Messages not saved yet stay in the log buffers and persistent log, e.g. when saving is
+ * deferred till next boot before hibernation
+ */
+void log_print_pending(void) {
+    drain_records();
+
+    // Report messages dropped because the buffer was full
+    uint32_t dropped = stats.dropped_records;
+    if (dropped != reported_drops) {
+        log_warn("%u log messages dropped\n", dropped - reported_drops);
+        reported_drops = dropped;
+        drain_records();
+    }
+
     // print message
-    if (read_idx != write_idx) {
-        char bk = log_buffer.buffer[write_idx & BUFFER_MASK];
-        log_buffer.buffer[write_idx & BUFFER_MASK] = '\0';
-        printf("%s", &log_buffer.buffer[read_idx & BUFFER_MASK]);
-        log_buffer.buffer[write_idx & BUFFER_MASK] = bk;
-        read_idx = write_idx;
+    uint32_t print_idx = log_text.print_idx;
+    uint32_t write_idx = log_text.write_idx;
+    if (print_idx != write_idx) {
+        uint32_t start = print_idx & TEXT_BUFFER_MASK;
+        uint32_t len = write_idx - print_idx;
+        if (start + len > TEXT_BUFFER_SIZE) {
+            printf("%.*s", (int)(TEXT_BUFFER_SIZE - start), &log_text.buffer[start]);
+            len -= TEXT_BUFFER_SIZE - start;
+            start = 0;
+        }
+        printf("%.*s", (int)len, &log_text.buffer[start]);
+        log_text.print_idx = write_idx;
     }
     
     stdio_flush();
 
-    // save to file
-    if (is_log_saving_to_file() && get_absolute_time() >= SUPPRESS_LOG_FILE_SAVING_US && (!is_usb_msc_device_mounted() || log_buffer.write_idx - log_buffer.file_idx > BUFFER_SIZE - MAX_MESSAGE_SIZE)) {
-        save_logs_to_file();
+    // Nothing to keep for next boot if log is not saved to file
+    if (!is_log_saving_to_file()) {
+        persist_mark_saved();
     }
+}
 
-    __dmb();
-    log_buffer.read_idx = read_idx;
+
+// Write pending data in a ring buffer as at most two spans: the tail before wrapping around, and then the head
+static FRESULT write_ring(FIL *fp, const uint8_t *buffer, uint32_t size, uint32_t file_idx, uint32_t write_idx) {
+    uint32_t available = write_idx - file_idx;
+    uint32_t start = file_idx & (size - 1);
+    uint32_t tail = size - start;
+    UINT bw;
+    if (available <= tail) {
+        return f_write(fp, &buffer[start], available, &bw);
+    }
+    FRESULT res = f_write(fp, &buffer[start], tail, &bw);
+    if (res == FR_OK) {
+        res = f_write(fp, &buffer[0], available - tail, &bw);
+    }
+    return res;
+}
+
+
+/**
+ * Close the log file that is kept open for appending
+ *
+ * It must be called before log files get changed by others (deleted, overwritten,
+ * disk formatted or unmounted), the file will be opened again at next saving.
+ * The rotated log file being compressed is closed too, its compression starts over later.
+ */
+void close_log_file(void) {
+    if (log_file_open) {
+        f_close(&log_file);
+        log_file_open = false;
+    }
+    if (compressing) {
+        // Rotated file stays uncompressed, compression starts over later
+        f_close(&compress_src);
+        f_close(&compress_dst);
+        compressing = false;
+        compress_pending = true;
+    }
+}
+
+
+// Open current log file for appending, or keep using the opened one if it is still valid
+static FRESULT open_log_file(void) {
+    if (log_file_open && (log_file_format != file_format || log_file_host_writes != get_fatfs_host_write_count())) {
+        close_log_file();   // The USB host may have changed the file
+    }
+    if (!log_file_open) {
+        FRESULT res = f_open(&log_file, log_file_paths[file_format][0], FA_OPEN_APPEND | FA_WRITE);
+        if (res != FR_OK) {
+            return res;
+        }
+        log_file_open = true;
+        log_file_format = file_format;
+        log_file_host_writes = get_fatfs_host_write_count();
+    }
+    return FR_OK;
+}
+
+
+// Rename log files to start a new one: WittyPi5.log -> WittyPi5.1 -> WittyPi5.2 (the oldest one is deleted)
+static void rotate_log_files(void) {
+    const char *const *paths = log_file_paths[file_format];
+    const char *const *archives = log_archive_paths[file_format];
+    close_log_file();
+    f_unlink(paths[LOG_FILE_GENERATIONS - 1]);
+    f_unlink(archives[LOG_FILE_GENERATIONS - 1]);
+    for (int i = LOG_FILE_GENERATIONS - 1; i > 0; i--) {
+        f_rename(paths[i - 1], paths[i]);
+        if (i > 1) {
+            f_rename(archives[i - 1], archives[i]);
+        }
+    }
+    compress_pending = true;
+    log_info("Log file rotated\n");
+}
+
+
+// Find a rotated log file that is not compressed yet, and start compressing it
+static bool start_compression(void) {
+    for (uint8_t format = 0; format < 2; format++) {
+        for (uint8_t gen = 1; gen < LOG_FILE_GENERATIONS; gen++) {
+            if (f_open(&compress_src, log_file_paths[format][gen], FA_READ) != FR_OK) {
+                continue;
+            }
+            // An existing compressed file is incomplete if the original file is still there
+            uint8_t header[LZ_HEADER_SIZE];
+            UINT bw;
+            lz_write_header(header, f_size(&compress_src));
+            if (f_open(&compress_dst, log_archive_paths[format][gen], FA_WRITE | FA_CREATE_ALWAYS) != FR_OK
+                || f_write(&compress_dst, header, sizeof(header), &bw) != FR_OK) {
+                log_warn("Can not create %s\n", log_archive_paths[format][gen]);
+                f_close(&compress_src);
+                f_close(&compress_dst);
+                return false;
+            }
+            lz_init(&lz_encoder);
+            compress_format = format;
+            compress_generation = gen;
+            compressing = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Compress next piece of the rotated log file, replace the original file with compressed one at the end
+static void compress_step(void) {
+    static uint8_t in[LZ_MAX_INPUT];
+    static uint8_t out[LZ_MAX_OUTPUT];
+    const char *src_path = log_file_paths[compress_format][compress_generation];
+    const char *dst_path = log_archive_paths[compress_format][compress_generation];
+    UINT br, bw;
+    FRESULT res = f_read(&compress_src, in, sizeof(in), &br);
+    size_t len = 0;
+    if (res == FR_OK) {
+        len = br ? lz_encode(&lz_encoder, in, br, out) : lz_finish(&lz_encoder, out);
+        res = f_write(&compress_dst, out, len, &bw);
+    }
+    if (res == FR_OK && br) {
+        return;
+    }
+    uint32_t src_size = f_size(&compress_src);
+    uint32_t dst_size = f_size(&compress_dst);
+    f_close(&compress_src);
+    if (res == FR_OK) {
+        res = f_close(&compress_dst);
+    } else {
+        f_close(&compress_dst);
+    }
+    compressing = false;
+    if (res != FR_OK) {
+        log_warn("Compress %s failed (%u)\n", src_path, res);
+        f_unlink(dst_path);
+        compress_pending = false;   // Try again after next rotation
+        return;
+    }
+    f_unlink(src_path);
+    compress_pending = true;    // Check for more files
+    log_info("Log file compressed: %s (%u bytes) -> %s (%u bytes)\n", src_path, src_size, dst_path, dst_size);
+}
+
+
+/**
+ * Compress rotated log files into .lz files in idle time, a small piece at each call
+ */
+void process_log_compress_task(void) {
+    if (!compressing && !compress_pending) {
+        return;
+    }
+    if (!is_fatfs_mounted() || is_usb_msc_device_mounted()
+        || get_absolute_time() < SUPPRESS_LOG_FILE_SAVING_US
+        || i2c_get_idle_time_us() < LOG_COMPRESS_I2C_IDLE_US) {
+        return;
+    }
+    if (!compressing) {
+        compress_pending = false;
+        if (!start_compression()) {
+            return;
+        }
+    }
+    compress_step();
 }
 
 
@@ -147,25 +982,140 @@ void process_log_task(void) {
  */
 void save_logs_to_file(void) {
 
-    uint32_t available = log_buffer.write_idx - log_buffer.file_idx;
+    drain_records();
 
-    if (available > 0) {
+    bool binary = (file_format == LOG_FILE_FORMAT_BINARY);
+    uint32_t file_idx = binary ? log_bin.file_idx : log_text.file_idx;
+    uint32_t write_idx = binary ? log_bin.write_idx : log_text.write_idx;
 
-        static FIL fp = {0};
+    if (write_idx != file_idx) {
 
-        FRESULT res = f_open(&fp, LOG_FILE_PATH, FA_OPEN_APPEND | FA_WRITE);
+        FRESULT res = open_log_file();
+        uint32_t limit = conf_get(CONF_LOG_FILE_SIZE) * LOG_FILE_SIZE_UNIT;
+        if (res == FR_OK && limit && f_size(&log_file) > 0 && f_size(&log_file) + (write_idx - file_idx) > limit) {
+            rotate_log_files();
+            res = open_log_file();
+        }
         if (res != FR_OK) {
             printf("Open log file failed (%u)\n", res);
+            return;
         }
-        for (size_t i = 0; i < available; i++) {
 
-            f_write(&fp, &log_buffer.buffer[(log_buffer.file_idx + i) & BUFFER_MASK], 1, NULL);
+        if (binary) {
+            if (f_size(&log_file) == 0) {
+                // New file starts with magic and the time that the first event refers to
+                uint8_t header[LOG_BIN_MAGIC_SIZE + 9];
+                memcpy(header, LOG_BIN_MAGIC, LOG_BIN_MAGIC_SIZE);
+                header[LOG_BIN_MAGIC_SIZE] = LOG_BIN_TIME;
+                for (int i = 0; i < 8; i++) {
+                    header[LOG_BIN_MAGIC_SIZE + 1 + i] = (uint8_t)(log_bin.pending_timestamp >> (8 * i));
+                }
+                UINT bw;
+                f_write(&log_file, header, sizeof(header), &bw);
+            }
+            res = write_ring(&log_file, log_bin.buffer, BIN_BUFFER_SIZE, file_idx, write_idx);
+            log_bin.file_idx = write_idx;
+        } else {
+            res = write_ring(&log_file, (const uint8_t *)log_text.buffer, TEXT_BUFFER_SIZE, file_idx, write_idx);
+            log_text.file_idx = write_idx;
         }
 
-        log_buffer.file_idx = log_buffer.write_idx;
+        // Directory entry and FAT are updated at every saving, the open file never gets lost at power off
+        if (res == FR_OK) {
+            res = f_sync(&log_file);
+        }
+        if (res != FR_OK) {
+            printf("Write log file failed (%u)\n", res);
+            close_log_file();
+            return;
+        }
+    }
+    persist_mark_saved();
+}
+
+
+/**
+ * Check whether saving log to file can be deferred till next boot (e.g. before hibernation)
+ *
+ * Messages not saved yet are kept in RAM that is not initialized at boot, and next boot
+ * saves them. It is not possible when that RAM is nearly full.
+ *
+ * @return true if saving can be deferred
+ */
+bool log_can_defer_saving(void) {
+    return persist_restored && log_persist.write_idx - log_persist.file_idx <= PERSIST_MAX_DEFERRED;
+}
+
 
-        f_sync(&fp);
+/**
+ * Get the number of bytes of persistent log that are not saved to file yet
+ *
+ * @return The number of bytes
+ */
+uint32_t log_get_persist_pending(void) {
+    return persist_restored ? log_persist.write_idx - log_persist.file_idx : 0;
+}
 
-        f_close(&fp);
+
+/**
+ * Get the address of persistent log, its SRAM bank must stay powered to keep it during hibernation
+ *
+ * @return The address of persistent log
+ */
+const void *log_get_persist_address(void) {
+    return &log_persist;
+}
+
+
+/**
+ * Get the number of bytes that I2C log tail has not read yet, can be called from IRQ
+ *
+ * If the reader is too slow, the oldest text is skipped till the beginning of next line.
+ * 
+ * @return The number of bytes available for reading
+ */
+uint32_t log_tail_available(void) {
+    uint32_t write_idx = log_text.write_idx;
+    uint32_t available = write_idx - tail_idx;
+    if (available > TAIL_MAX_AVAILABLE) {
+        uint32_t idx = write_idx - TAIL_MAX_AVAILABLE;
+        while (idx != write_idx && log_text.buffer[idx++ & TEXT_BUFFER_MASK] != '\n');
+        stats.tail_skipped_bytes += idx - tail_idx;
+        tail_idx = idx;
+        available = write_idx - idx;
     }
+    return available;
+}
+
+
+/**
+ * Read next byte of log text for I2C log tail, can be called from IRQ
+ * 
+ * @return The byte read, or 0 if there is nothing to read
+ */
+uint8_t log_tail_read(void) {
+    if (log_tail_available() == 0) {
+        return 0;
+    }
+    uint8_t data = log_text.buffer[tail_idx & TEXT_BUFFER_MASK];
+    tail_idx++;
+    return data;
+}
+
+
+/**
+ * Skip all text that I2C log tail has not read yet, can be called from IRQ
+ */
+void log_tail_skip(void) {
+    tail_idx = log_text.write_idx;
+}
+
+
+/**
+ * Get the statistics of log buffer
+ * 
+ * @param out Pointer to the statistics to fill
+ */
+void log_get_stats(log_stats_t *out) {
+    *out = stats;
 }
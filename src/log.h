@@ -1,6 +1,56 @@
 #ifndef _LOG_H_
 #define _LOG_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// Severity levels of log messages
+#define LOG_LEVEL_DEBUG     0
+#define LOG_LEVEL_INFO      1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_ERROR     3
+#define LOG_LEVEL_NONE      4
+
+// Messages below this level are removed at compile time, it can be set for the build (-DLOG_MIN_LEVEL=2)
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL       LOG_LEVEL_DEBUG
+#endif
+
+// Minimum level of the module, a module can define its own before including this file
+#ifndef LOG_MODULE_LEVEL
+#define LOG_MODULE_LEVEL    LOG_MIN_LEVEL
+#endif
+
+// Log a message at given level. The module that uses these macros defines LOG_MODULE (tag string
+// of the module). The level letter and tag become part of the format string, so they cost nothing at runtime.
+#define LOG_AT(level, letter, fmt, ...) \
+    do { \
+        if ((level) >= LOG_MIN_LEVEL && (level) >= LOG_MODULE_LEVEL) { \
+            log_message((level), letter " " LOG_MODULE ": " fmt, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define log_debug(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, "D", fmt, ##__VA_ARGS__)
+#define log_info(fmt, ...)  LOG_AT(LOG_LEVEL_INFO, "I", fmt, ##__VA_ARGS__)
+#define log_warn(fmt, ...)  LOG_AT(LOG_LEVEL_WARN, "W", fmt, ##__VA_ARGS__)
+#define log_error(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, "E", fmt, ##__VA_ARGS__)
+
+
+typedef struct {
+    uint32_t dropped_records;   // Number of messages dropped because the buffer was full
+    uint32_t dropped_bytes;     // Number of bytes in dropped messages
+    uint32_t dropped_file_bytes;    // Number of binary log bytes discarded before saved to file
+    uint32_t tail_skipped_bytes;    // Number of bytes skipped because I2C log tail was too slow
+} log_stats_t;
+
+
+/**
+ * Initialize the runtime log level from configuration
+ */
+void log_init(void);
+
 
 /**
  * Check whether the log should be saved to file
@@ -19,23 +69,135 @@ void log_save_to_file(bool s2f);
 
 
 /**
- * Submit a log message
+ * Write a message into log buffer as one record, can be called from any context
+ * 
+ * @param data The message text, the time header will be added
+ * @param len The length of message
+ * @return true if written, false if the buffer is full
+ */
+bool log_write(const char* data, size_t len);
+
+
+/**
+ * Submit a log message without level (never filtered), it is formatted later in main loop when possible
  * 
- * @param fmt The printf format of the message
+ * @param fmt The printf format of the message, must be a string literal
  */
 void debug_log(const char* fmt, ...);
 
 
+/**
+ * Submit a log message with severity level, it is dropped if the level is below the runtime log level
+ * 
+ * @param level The severity level (LOG_LEVEL_???)
+ * @param fmt The printf format of the message, must be a string literal
+ */
+void log_message(uint8_t level, const char* fmt, ...);
+
+
 /**
  * Print logs to serial port, save logs to file if needed
  */
 void process_log_task(void);
 
 
+/**
+ * Print logs to serial port without saving them to file
+ *
+ * Messages not saved yet stay in the log buffers and persistent log, e.g. when saving is
+ * deferred till next boot before hibernation
+ */
+void log_print_pending(void);
+
+
+/**
+ * Queue the messages that previous run did not save to file
+ *
+ * It should be called at boot before anything is logged, so they are saved before the
+ * messages of this run. Otherwise it is done when the log is processed the first time.
+ */
+void log_restore_persistent(void);
+
+
 /**
  * Save logs to file
  */
 void save_logs_to_file(void);
 
 
+/**
+ * Compress rotated log files into .lz files in idle time, a small piece at each call
+ */
+void process_log_compress_task(void);
+
+
+/**
+ * Close the log file that is kept open for appending
+ *
+ * It must be called before log files get changed by others (deleted, overwritten,
+ * disk formatted or unmounted), the file will be opened again at next saving.
+ * The rotated log file being compressed is closed too, its compression starts over later.
+ */
+void close_log_file(void);
+
+
+/**
+ * Check whether saving log to file can be deferred till next boot (e.g. before hibernation)
+ *
+ * Messages not saved yet are kept in RAM that is not initialized at boot, and next boot
+ * saves them. It is not possible when that RAM is nearly full.
+ *
+ * @return true if saving can be deferred
+ */
+bool log_can_defer_saving(void);
+
+
+/**
+ * Get the number of bytes of persistent log that are not saved to file yet
+ *
+ * @return The number of bytes
+ */
+uint32_t log_get_persist_pending(void);
+
+
+/**
+ * Get the address of persistent log, its SRAM bank must stay powered to keep it during hibernation
+ *
+ * @return The address of persistent log
+ */
+const void *log_get_persist_address(void);
+
+
+/**
+ * Get the number of bytes that I2C log tail has not read yet, can be called from IRQ
+ *
+ * If the reader is too slow, the oldest text is skipped till the beginning of next line.
+ * 
+ * @return The number of bytes available for reading
+ */
+uint32_t log_tail_available(void);
+
+
+/**
+ * Read next byte of log text for I2C log tail, can be called from IRQ
+ * 
+ * @return The byte read, or 0 if there is nothing to read
+ */
+uint8_t log_tail_read(void);
+
+
+/**
+ * Skip all text that I2C log tail has not read yet, can be called from IRQ
+ */
+void log_tail_skip(void);
+
+
+/**
+ * Get the statistics of log buffer
+ * 
+ * @param out Pointer to the statistics to fill
+ */
+void log_get_stats(log_stats_t *out);
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,143 @@
+#ifndef _LOG_FORMAT_H_
+#define _LOG_FORMAT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// Binary log file format, shared by firmware and the decoder (tools/host/log_decode.c)
+//
+// The file starts with LOG_BIN_MAGIC, followed by events. Every event starts with a
+// varint tag: (milliseconds since previous event << 2) | kind.
+//   LOG_BIN_TIME:    8-byte little endian absolute time in ms, the delta in tag is 0
+//   LOG_BIN_MESSAGE: 3-byte little endian message id, then packed arguments:
+//                    zigzag varint for %d/%i, varint for other integers,
+//                    NUL-terminated bytes for %s
+//   LOG_BIN_TEXT:    varint length, then the message text
+//
+// The message id is the hash of format string (log_format_id), the decoder finds the format
+// in the table generated from debug_log() call sites by tools/log_formats.py.
+
+#define LOG_BIN_MAGIC           "WLOG\x01"
+#define LOG_BIN_MAGIC_SIZE      5
+
+#define LOG_BIN_TIME            0
+#define LOG_BIN_MESSAGE         1
+#define LOG_BIN_TEXT            2
+
+#define LOG_BIN_KIND_BITS       2
+#define LOG_BIN_KIND_MASK       3
+
+#define LOG_BIN_ID_SIZE         3
+
+
+// Type of argument for a conversion specification in format string
+typedef enum {
+    LOG_ARG_NONE,           // "%%"
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LONG_LONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_STRING,
+    LOG_ARG_UNSUPPORTED     // Floating point, '*' width etc.
+} log_arg_t;
+
+
+/**
+ * Parse the conversion specification in format string
+ *
+ * @param p Pointer to the character after '%'
+ * @param arg Pointer to receive the type of argument
+ * @param is_signed Pointer to receive whether the integer is signed (%d or %i)
+ * @return The pointer to the conversion character
+ */
+static inline const char *log_parse_spec(const char *p, log_arg_t *arg, bool *is_signed) {
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') p++;
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    int longs = 0;
+    bool size = false;
+    while (*p == 'l' || *p == 'h' || *p == 'z') {
+        if (*p == 'l') longs++;
+        if (*p == 'z') size = true;
+        p++;
+    }
+    *is_signed = (*p == 'd' || *p == 'i');
+    switch (*p) {
+        case '%':
+            *arg = LOG_ARG_NONE;
+            break;
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            *arg = size ? LOG_ARG_SIZE : (longs >= 2 ? LOG_ARG_LONG_LONG : (longs ? LOG_ARG_LONG : LOG_ARG_INT));
+            break;
+        case 's':
+            *arg = longs ? LOG_ARG_UNSUPPORTED : LOG_ARG_STRING;
+            break;
+        default:
+            *arg = LOG_ARG_UNSUPPORTED;
+            break;
+    }
+    return p;
+}
+
+
+/**
+ * Get the message id of a format string (FNV-1a hash folded to 24 bits)
+ *
+ * @param format The format string
+ * @return The message id
+ */
+static inline uint32_t log_format_id(const char *format) {
+    uint32_t hash = 2166136261u;
+    while (*format) {
+        hash ^= (uint8_t)*format++;
+        hash *= 16777619u;
+    }
+    return (hash ^ (hash >> 24)) & 0xFFFFFF;
+}
+
+
+/**
+ * Encode an unsigned value as varint (7 bits per byte, little endian)
+ *
+ * @param buf The buffer to write, must have space for 10 bytes
+ * @param value The value to encode
+ * @return The number of bytes written
+ */
+static inline int log_put_varint(uint8_t *buf, uint64_t value) {
+    int n = 0;
+    while (value >= 0x80) {
+        buf[n++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    buf[n++] = (uint8_t)value;
+    return n;
+}
+
+
+/**
+ * Decode a varint
+ *
+ * @param buf The buffer to read
+ * @param len The length of data in buffer
+ * @param value Pointer to receive the value
+ * @return The number of bytes read, 0 if the data is incomplete
+ */
+static inline int log_get_varint(const uint8_t *buf, size_t len, uint64_t *value) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < len && i < 10; i++) {
+        v |= (uint64_t)(buf[i] & 0x7F) << (7 * i);
+        if (!(buf[i] & 0x80)) {
+            *value = v;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef _LOG_TIME_H_
+#define _LOG_TIME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rtc.h"
+
+
+// Time in the header of log messages ("MM-DD HH:mm:ss.SSS"), shared by firmware and the
+// host benchmark (tools/host/log_time_bench.c)
+//
+// The calendar date is only calculated when the day changes, a timestamp in the same
+// day as the previous one is formatted from the milliseconds since the start of the day.
+
+#define LOG_TIME_LENGTH     18
+#define LOG_MS_PER_DAY      86400000LL
+
+
+// The day of the last formatted timestamp
+typedef struct {
+    int64_t start_ms;       // Start of the day, in ms since 1970
+    char date[5];           // "MM-DD"
+    bool valid;
+} log_day_t;
+
+
+/**
+ * Write an unsigned value as decimal digits with leading zeros
+ *
+ * @param buf The buffer to write
+ * @param value The value
+ * @param digits Number of digits to write
+ */
+static inline void log_put_digits(char *buf, uint32_t value, int digits) {
+    for (int i = digits - 1; i >= 0; i--) {
+        buf[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+
+/**
+ * Format a timestamp as "MM-DD HH:mm:ss.SSS"
+ *
+ * @param day The cached day, updated when the timestamp is in another day
+ * @param ms_timestamp The timestamp in ms since 1970
+ * @param buf The buffer to write, must have space for LOG_TIME_LENGTH + 1 bytes
+ */
+static inline void log_format_time(log_day_t *day, int64_t ms_timestamp, char *buf) {
+    int64_t ms = ms_timestamp - day->start_ms;
+    if (!day->valid || ms < 0 || ms >= LOG_MS_PER_DAY) {
+        int64_t ms_since_2000 = ms_timestamp - TIMESTAMP_2000_01_01 * 1000;
+        DateTime dt;
+        timestamp_to_datetime(ms_timestamp / 1000 - TIMESTAMP_2000_01_01, &dt);
+        if (ms_since_2000 < 0) {
+            // Time is not set yet, not worth caching
+            sprintf(buf, "%02d-%02d %02d:%02d:%02d.%03d", dt.month, dt.day, dt.hour, dt.min, dt.sec, (int)(ms_timestamp % 1000));
+            return;
+        }
+        log_put_digits(day->date, dt.month, 2);
+        day->date[2] = '-';
+        log_put_digits(day->date + 3, dt.day, 2);
+        day->start_ms = ms_timestamp - ms_since_2000 % LOG_MS_PER_DAY;
+        day->valid = true;
+        ms = ms_timestamp - day->start_ms;
+    }
+    uint32_t t = (uint32_t)ms;
+    memcpy(buf, day->date, 5);
+    buf[5] = ' ';
+    log_put_digits(buf + 6, t / 3600000, 2);
+    buf[8] = ':';
+    log_put_digits(buf + 9, t / 60000 % 60, 2);
+    buf[11] = ':';
+    log_put_digits(buf + 12, t / 1000 % 60, 2);
+    buf[14] = '.';
+    log_put_digits(buf + 15, t % 1000, 3);
+    buf[LOG_TIME_LENGTH] = '\0';
+}
+
+
+#endif
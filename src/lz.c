@@ -0,0 +1,187 @@
+#include <string.h>
+
+#include "lz.h"
+
+
+// Hash of the 3 bytes at given position
+static inline uint32_t hash3(const uint8_t *p) {
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+
+// Append bits to output, full bytes are written out
+static void put_bits(lz_encoder_t *enc, uint32_t value, int count, uint8_t *out, size_t *n) {
+    enc->bits = (enc->bits << count) | (value & ((1u << count) - 1));
+    enc->bit_count += count;
+    while (enc->bit_count >= 8) {
+        enc->bit_count -= 8;
+        out[(*n)++] = (uint8_t)(enc->bits >> enc->bit_count);
+    }
+}
+
+
+// Add the position to hash chains
+static void insert_position(lz_encoder_t *enc, uint32_t pos) {
+    if (pos + LZ_MIN_MATCH > enc->end) {
+        return;
+    }
+    uint32_t h = hash3(&enc->data[pos]);
+    enc->prev[pos & (LZ_WINDOW_SIZE - 1)] = enc->head[h];
+    enc->head[h] = pos + 1;
+}
+
+
+// Find the longest match in window, return its length (0 if shorter than LZ_MIN_MATCH)
+static uint32_t find_match(lz_encoder_t *enc, uint32_t max_len, uint32_t *distance) {
+    uint32_t pos = enc->pos;
+    uint32_t best = 0;
+    uint32_t candidate = enc->head[hash3(&enc->data[pos])];
+    for (int chain = 0; candidate && chain < LZ_MAX_CHAIN; chain++) {
+        uint32_t start = candidate - 1;
+        if (start >= pos || pos - start > LZ_WINDOW_SIZE) {
+            break;
+        }
+        uint32_t len = 0;
+        while (len < max_len && enc->data[start + len] == enc->data[pos + len]) {
+            len++;
+        }
+        if (len > best) {
+            best = len;
+            *distance = pos - start;
+            if (len == max_len) {
+                break;
+            }
+        }
+        candidate = enc->prev[start & (LZ_WINDOW_SIZE - 1)];
+    }
+    return best >= LZ_MIN_MATCH ? best : 0;
+}
+
+
+// Encode data till only the lookahead is left (or nothing is left when finishing)
+static size_t encode_data(lz_encoder_t *enc, bool finish, uint8_t *out) {
+    size_t n = 0;
+    while (enc->pos < enc->end && (finish || enc->end - enc->pos >= LZ_MAX_MATCH)) {
+        uint32_t max_len = enc->end - enc->pos;
+        if (max_len > LZ_MAX_MATCH) {
+            max_len = LZ_MAX_MATCH;
+        }
+        uint32_t distance = 0;
+        uint32_t len = max_len >= LZ_MIN_MATCH ? find_match(enc, max_len, &distance) : 0;
+        if (len) {
+            put_bits(enc, 0, 1, out, &n);
+            put_bits(enc, distance - 1, LZ_WINDOW_BITS, out, &n);
+            put_bits(enc, len - LZ_MIN_MATCH, LZ_LENGTH_BITS, out, &n);
+        } else {
+            len = 1;
+            put_bits(enc, 0x100 | enc->data[enc->pos], 9, out, &n);
+        }
+        for (uint32_t i = 0; i < len; i++) {
+            insert_position(enc, enc->pos++);
+        }
+    }
+    return n;
+}
+
+
+// Reverse the order of array elements in [from, to)
+static void reverse_u16(uint16_t *a, uint32_t from, uint32_t to) {
+    while (from + 1 < to) {
+        uint16_t t = a[from];
+        a[from++] = a[--to];
+        a[to] = t;
+    }
+}
+
+
+// Drop the data older than the window to make room for new data
+static void slide_window(lz_encoder_t *enc) {
+    if (enc->pos <= LZ_WINDOW_SIZE) {
+        return;
+    }
+    uint32_t shift = enc->pos - LZ_WINDOW_SIZE;
+    memmove(enc->data, enc->data + shift, enc->end - shift);
+    enc->pos -= shift;
+    enc->end -= shift;
+    for (int i = 0; i < (1 << LZ_HASH_BITS); i++) {
+        enc->head[i] = enc->head[i] > shift ? enc->head[i] - shift : 0;
+    }
+    // Chains are indexed by position in window, rotate them along with the data
+    uint32_t r = shift & (LZ_WINDOW_SIZE - 1);
+    reverse_u16(enc->prev, 0, r);
+    reverse_u16(enc->prev, r, LZ_WINDOW_SIZE);
+    reverse_u16(enc->prev, 0, LZ_WINDOW_SIZE);
+    for (uint32_t i = 0; i < LZ_WINDOW_SIZE; i++) {
+        enc->prev[i] = enc->prev[i] > shift ? enc->prev[i] - shift : 0;
+    }
+}
+
+
+/**
+ * Initialize the encoder for a new stream
+ *
+ * @param enc Pointer to the encoder
+ */
+void lz_init(lz_encoder_t *enc) {
+    memset(enc->head, 0, sizeof(enc->head));
+    memset(enc->prev, 0, sizeof(enc->prev));
+    enc->pos = 0;
+    enc->end = 0;
+    enc->bits = 0;
+    enc->bit_count = 0;
+}
+
+
+/**
+ * Write the file header
+ *
+ * @param out The buffer to write, must have space for LZ_HEADER_SIZE bytes
+ * @param size The size of original data
+ */
+void lz_write_header(uint8_t *out, uint32_t size) {
+    memcpy(out, LZ_MAGIC, LZ_MAGIC_SIZE);
+    out[LZ_MAGIC_SIZE] = LZ_WINDOW_BITS;
+    out[LZ_MAGIC_SIZE + 1] = LZ_LENGTH_BITS;
+    for (int i = 0; i < 4; i++) {
+        out[LZ_MAGIC_SIZE + 2 + i] = (uint8_t)(size >> (8 * i));
+    }
+}
+
+
+/**
+ * Compress data, the last few bytes are kept till more data comes or lz_finish() is called
+ *
+ * @param enc Pointer to the encoder
+ * @param in The data to compress
+ * @param len The length of data, at most LZ_MAX_INPUT
+ * @param out The buffer to write, must have space for LZ_MAX_OUTPUT bytes
+ * @return The number of bytes written to out
+ */
+size_t lz_encode(lz_encoder_t *enc, const uint8_t *in, size_t len, uint8_t *out) {
+    if (len > LZ_MAX_INPUT) {
+        len = LZ_MAX_INPUT;
+    }
+    if (enc->end + len > sizeof(enc->data)) {
+        slide_window(enc);
+    }
+    memcpy(enc->data + enc->end, in, len);
+    enc->end += len;
+    return encode_data(enc, false, out);
+}
+
+
+/**
+ * Compress the remaining data and end the stream
+ *
+ * @param enc Pointer to the encoder
+ * @param out The buffer to write, must have space for LZ_MAX_OUTPUT bytes
+ * @return The number of bytes written to out
+ */
+size_t lz_finish(lz_encoder_t *enc, uint8_t *out) {
+    size_t n = encode_data(enc, true, out);
+    if (enc->bit_count > 0) {
+        put_bits(enc, 0, 8 - enc->bit_count, out, &n);
+    }
+    return n;
+}
@@ -0,0 +1,89 @@
+#ifndef _LZ_H_
+#define _LZ_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// Streaming LZ compressor for log files, the format is shared with the decoder (tools/host/lz_decode.c)
+//
+// File header (LZ_HEADER_SIZE bytes):
+//   LZ_MAGIC, window bits, length bits, 4-byte little endian size of original data
+// Followed by a bit stream, most significant bit first:
+//   1 + 8 bits:                         literal byte
+//   0 + window bits + length bits:      copy (distance - 1) and (length - LZ_MIN_MATCH)
+// The stream is padded with zero bits to the byte boundary, the decoder stops at the original size.
+//
+// The encoder only keeps a window of recent data and a hash chain index, about 10KB of RAM.
+
+#define LZ_MAGIC            "WLZ\x01"
+#define LZ_MAGIC_SIZE       4
+#define LZ_HEADER_SIZE      (LZ_MAGIC_SIZE + 6)
+
+#define LZ_WINDOW_BITS      11
+#define LZ_WINDOW_SIZE      (1 << LZ_WINDOW_BITS)
+#define LZ_LENGTH_BITS      4
+#define LZ_MIN_MATCH        3
+#define LZ_MAX_MATCH        (LZ_MIN_MATCH + (1 << LZ_LENGTH_BITS) - 1)
+
+#define LZ_HASH_BITS        10
+#define LZ_MAX_CHAIN        16          // Number of earlier positions tried for a match
+
+#define LZ_MAX_INPUT        512         // Maximum input for one lz_encode() call
+
+// Output buffer size that is always enough for one lz_encode() or lz_finish() call
+#define LZ_MAX_OUTPUT       ((LZ_MAX_INPUT + LZ_MAX_MATCH) * 9 / 8 + 4)
+
+
+typedef struct {
+    uint8_t data[2 * LZ_WINDOW_SIZE];   // Window of encoded data, then the data not encoded yet
+    uint16_t head[1 << LZ_HASH_BITS];   // Latest position + 1 of each hash, 0 for none
+    uint16_t prev[LZ_WINDOW_SIZE];      // Previous position + 1 with the same hash, indexed by position in window
+    uint32_t pos;                       // Next position to encode
+    uint32_t end;                       // End of data
+    uint32_t bits;                      // Output bits not written yet
+    int bit_count;
+} lz_encoder_t;
+
+
+/**
+ * Initialize the encoder for a new stream
+ *
+ * @param enc Pointer to the encoder
+ */
+void lz_init(lz_encoder_t *enc);
+
+
+/**
+ * Write the file header
+ *
+ * @param out The buffer to write, must have space for LZ_HEADER_SIZE bytes
+ * @param size The size of original data
+ */
+void lz_write_header(uint8_t *out, uint32_t size);
+
+
+/**
+ * Compress data, the last few bytes are kept till more data comes or lz_finish() is called
+ *
+ * @param enc Pointer to the encoder
+ * @param in The data to compress
+ * @param len The length of data, at most LZ_MAX_INPUT
+ * @param out The buffer to write, must have space for LZ_MAX_OUTPUT bytes
+ * @return The number of bytes written to out
+ */
+size_t lz_encode(lz_encoder_t *enc, const uint8_t *in, size_t len, uint8_t *out);
+
+
+/**
+ * Compress the remaining data and end the stream
+ *
+ * @param enc Pointer to the encoder
+ * @param out The buffer to write, must have space for LZ_MAX_OUTPUT bytes
+ * @return The number of bytes written to out
+ */
+size_t lz_finish(lz_encoder_t *enc, uint8_t *out);
+
+
+#endif
@@ -8,6 +8,7 @@
 #include <tusb.h>
 
 #include "flash.h"
+#include "ftl.h"
 #include "log.h"
 #include "rtc.h"
 #include "ts.h"
@@ -28,6 +29,9 @@
 #include "hibernate.h"
 
 
+#define LOG_MODULE          "main"
+
+
 #define VOLTAGE_CHECK_INTERVAL_US	1000000
 
 #define ACTION_RETRY_INTERVAL_US	60000000
@@ -58,19 +62,19 @@ void perform_temp_action(uint8_t action, bool below, bool retry);
 void log_current_rpi_state(void) {
     switch (current_rpi_state) {
         case STATE_OFF:
-            debug_log("Raspberry Pi is not powered.\n");
+            log_info("Raspberry Pi is not powered.\n");
             break;
         case STATE_STARTING:
-            debug_log("Raspberry Pi is starting up.\n");
+            log_info("Raspberry Pi is starting up.\n");
             break;
         case STATE_ON:
-            debug_log("Raspberry Pi is running.\n");
+            log_info("Raspberry Pi is running.\n");
             break;
         case STATE_STOPPING:
-            debug_log("Raspberry Pi is shutting down.\n");
+            log_info("Raspberry Pi is shutting down.\n");
             break;
         default:
-            debug_log("Raspberry Pi is in unknown state: %d\n", current_rpi_state);
+            log_info("Raspberry Pi is in unknown state: %d\n", current_rpi_state);
             break;
     }
 }
@@ -78,7 +82,7 @@ void log_current_rpi_state(void) {
 
 // Callback for cancelling factory reset
 int64_t factory_reset_cancel_callback(alarm_id_t id, void *user_data) {
-    debug_log("Factory reset cancelled.\n");
+    log_info("Factory reset cancelled.\n");
 	factory_reset_pending = false;
 	cancel_alarm(factory_reset_blink_alarm_id);
     return 0;
@@ -94,7 +98,7 @@ int64_t factory_reset_blink_callback(alarm_id_t id, void *user_data) {
 
 // Callback for long pressing BOOTSEL button
 void bootsel_long_pressed_callback() {
-	debug_log("Factory reset is pending, wait for button click...\n");
+	log_info("Factory reset is pending, wait for button click...\n");
 	factory_reset_pending = true;
 	cancel_alarm(factory_reset_cancel_alarm_id);
 	factory_reset_cancel_alarm_id = add_alarm_in_us(FACTORY_RESET_TIMEOUT_US, factory_reset_cancel_callback, NULL, true);
@@ -116,7 +120,7 @@ void button_released_callback() {
 		cancel_alarm(factory_reset_cancel_alarm_id);
 		cancel_alarm(factory_reset_blink_alarm_id);
 		tud_msc_start_stop_cb(0, 0, false, true);
-		debug_log("Factory reset in progress...\n");
+		log_info("Factory reset in progress...\n");
 		control_led(true, 0);
 
 		// Format the disk
@@ -125,11 +129,11 @@ void button_released_callback() {
 		mount_fatfs();
 		create_default_dirs();
 
-		// Re-initialize configration
-		conf_init();
+		// Reset configration, it will be saved to the new disk
+		conf_reset();
 
 		control_led(false, 0);
-		debug_log("Factory reset done.\n");
+		log_info("Factory reset done.\n");
 		factory_reset_pending = false;
 
 	} else if (!is_rpi_powered()) {	// Raspberry Pi is not powered, request startup
@@ -152,7 +156,7 @@ void button_long_pressed_callback() {
 
 // Callback for scheduled shutdown
 int64_t shutdown_alarm_callback(alarm_id_t id, void *user_data) {
-    debug_log("Scheduled shutdown is due.\n");
+    log_info("Scheduled shutdown is due.\n");
     request_shutdown(false, ACTION_REASON_ALARM2);
     return 0;
 }
@@ -160,14 +164,14 @@ int64_t shutdown_alarm_callback(alarm_id_t id, void *user_data) {
 
 // Callback for scheduled startup (might also be used for retry)
 int64_t startup_alarm_callback(alarm_id_t id, void *user_data) {
-    debug_log("Scheduled startup is due.\n");
+    log_info("Scheduled startup is due.\n");
 	bool vin_cond = !can_vin_turn_off_rpi();
 	bool temp_cond = !can_temperature_turn_off_rpi();
 	if (vin_cond && temp_cond) {
 		request_startup(ACTION_REASON_ALARM1);
 		return 0;
 	} else {
-		debug_log("Scheduled startup is postponed due to %s.\n", vin_cond ? (temp_cond ? "nothing" : "temperature") : (temp_cond ? "Vin" : "Vin and temperature"));
+		log_warn("Scheduled startup is postponed due to %s.\n", vin_cond ? (temp_cond ? "nothing" : "temperature") : (temp_cond ? "Vin" : "Vin and temperature"));
 		postponed_action_alarm_id = id;
 		return ACTION_RETRY_INTERVAL_US;
 	}
@@ -179,7 +183,7 @@ void rtc_alarm_occuried_callback() {
     uint8_t type = rtc_get_alarm_type();
     if (type == ALARM_TYPE_SHUTDOWN) {
 		int seconds = bcd_to_dec(conf_get(CONF_ALARM2_SECOND));
-        debug_log("Will shutdown in %d second.\n", seconds);
+        log_info("Will shutdown in %d second.\n", seconds);
         cancel_alarm(startup_alarm_id);
         startup_alarm_id = -1;
         cancel_alarm(postponed_action_alarm_id);
@@ -188,7 +192,7 @@ void rtc_alarm_occuried_callback() {
         shutdown_alarm_id = add_alarm_in_us((int64_t)seconds * 1000000, shutdown_alarm_callback, NULL, true);
     } else if (type == ALARM_TYPE_STARTUP) {
 		int seconds = bcd_to_dec(conf_get(CONF_ALARM1_SECOND));
-        debug_log("Will startup in %d second.\n", seconds);
+        log_info("Will startup in %d second.\n", seconds);
         cancel_alarm(shutdown_alarm_id);
         shutdown_alarm_id = -1;
         cancel_alarm(postponed_action_alarm_id);
@@ -196,7 +200,7 @@ void rtc_alarm_occuried_callback() {
         cancel_alarm(startup_alarm_id);
         startup_alarm_id = add_alarm_in_us((int64_t)seconds * 1000000, startup_alarm_callback, NULL, true);
     } else {
-        debug_log("Alarm occurs in wrong state: rpi_state=%d, alarm_type=%d\n", current_rpi_state, type);
+        log_warn("Alarm occurs in wrong state: rpi_state=%d, alarm_type=%d\n", current_rpi_state, type);
     }
 }
 
@@ -219,7 +223,7 @@ int64_t retry_below_temp_startup_callback(alarm_id_t id, void *user_data) {
 void perform_temp_action(uint8_t action, bool below, bool retry) {
 	if (action == TEMP_ACTION_STARTUP) {
 	    if (current_rpi_state == STATE_ON || current_rpi_state == STATE_STARTING) {
-            debug_log("%s-temperature startup is ignored because Raspberry Pi is already on.\n",
+            log_warn("%s-temperature startup is ignored because Raspberry Pi is already on.\n",
                       below ? "Below" : "Over");
             return;
         }
@@ -227,10 +231,10 @@ void perform_temp_action(uint8_t action, bool below, bool retry) {
 		bool time_cond = !can_cur_time_turn_off_rpi();
 		bool state_cond = current_rpi_state == STATE_OFF;
 		if (vin_cond && time_cond && state_cond) {
-		    debug_log("%s-temperature startup %s.\n", below ? "Below" : "Over", retry ? "succeeds with retry" : "occurs");
+		    log_info("%s-temperature startup %s.\n", below ? "Below" : "Over", retry ? "succeeds with retry" : "occurs");
 			request_startup(below ? ACTION_REASON_BELOW_TEMPERATURE : ACTION_REASON_OVER_TEMPERATURE);
 		} else {
-			debug_log("%s-temperature startup is postponed %s(reason: %s%s%s).\n",
+			log_warn("%s-temperature startup is postponed %s(reason: %s%s%s).\n",
 				below ? "Below" : "Over",
 			    retry ? "again " : "",
 			    vin_cond ? "" : "Vin",
@@ -243,7 +247,7 @@ void perform_temp_action(uint8_t action, bool below, bool retry) {
                                                         true);
 		}
 	} else if (action == TEMP_ACTION_SHUTDOWN) {
-		debug_log("%s-temperature shutdown occurs.\n", below ? "Below" : "Over");
+		log_info("%s-temperature shutdown occurs.\n", below ? "Below" : "Over");
 		request_shutdown(false, below ? ACTION_REASON_BELOW_TEMPERATURE : ACTION_REASON_OVER_TEMPERATURE);
 	}
 }
@@ -276,6 +280,10 @@ int main() {
 
 	stdio_init_all();
 
+    log_restore_persistent();   // Log not saved by previous run goes before new messages
+
+    ftl_init();     // Load flash sector map
+
     if(!mount_fatfs()) {  // Mount file system
         bootsel_long_pressed_callback();    // No file system, prepare for factory reset
     }
@@ -284,6 +292,8 @@ int main() {
 
     conf_init();    // Initialize configration
 
+    log_init();     // Apply log level in configuration
+
 	// Set System clock
 	uint32_t freq_mhz = (uint32_t)conf_get(CONF_SYS_CLOCK_MHZ);
 	if (freq_mhz == 48 || !set_sys_clock_khz(freq_mhz * 1000, false)) {
@@ -316,14 +326,14 @@ int main() {
     	uint32_t wake_flags = hibernate_get_wakeup_flags();
 
         if (wake_flags & WAKEUP_SOURCE_BUTTON) {
-            debug_log("Woke up by button.\n");
+            log_info("Woke up by button.\n");
             request_startup(ACTION_REASON_BUTTON_CLICK);
         } else if (wake_flags & WAKEUP_SOURCE_RTC) {
-            debug_log("Woke up by RTC alarm.\n");
+            log_info("Woke up by RTC alarm.\n");
             rtc_alarm_occuried_callback();
             rtc_clear_alarm_flag();
         } else if (wake_flags & WAKEUP_SOURCE_TS) {
-            debug_log("Woke up by temperature alert.\n");
+            log_info("Woke up by temperature alert.\n");
             ts_process_alert();
         } else if (wake_flags & WAKEUP_SOURCE_TIMER) {
             //debug_log("Woke up by pulse timer.\n");
@@ -340,7 +350,7 @@ int main() {
                 hibernate_skip_usb_grace();
                 int rc = hibernate_enter();
                 if (rc != PICO_OK) {
-                    debug_log("Failed to re-enter hibernation after pulse wake: %d\n", rc);
+                    log_error("Failed to re-enter hibernation after pulse wake: %d\n", rc);
                 }
             }
         }
@@ -356,7 +366,7 @@ int main() {
 	uint8_t default_on = conf_get(CONF_DEFAULT_ON_DELAY);
 	if (default_on != 255) {
 		sleep_ms((uint16_t)default_on * 1000);
-		debug_log("Raspberry Pi is turned on because \"Default ON\" is set.\n");
+		log_info("Raspberry Pi is turned on because \"Default ON\" is set.\n");
         request_startup(ACTION_REASON_POWER_CONNECTED);
 	}
 
@@ -376,16 +386,18 @@ int main() {
         i2c_process_pending_admin_command();  // Process deferred admin commands (FS ops outside I2C IRQ)
         rtc_process_pending_alarm_conf();  // Process deferred alarm configurations
         process_log_task();
+        process_log_compress_task();
         process_conf_task();
+        process_flash_task();
 		if (!factory_reset_pending && conf_get(CONF_BOOTSEL_FTY_RST)) {
 			check_bootsel_button(NULL, NULL, bootsel_long_pressed_callback);
 		}
 		if (current_rpi_state == STATE_OFF) {
     		if (hibernate_is_forced_entry_requested() || hibernate_can_enter()) {
-    		    debug_log("Entering hibernation...\n");
+    		    log_info("Entering hibernation...\n");
                 int rc = hibernate_enter();
                 if (rc != PICO_OK) {
-                    debug_log("Failed to enter hibernation: %d\n", rc);
+                    log_error("Failed to enter hibernation: %d\n", rc);
                 }
             }
         }
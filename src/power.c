@@ -16,6 +16,9 @@
 #include "hibernate.h"
 
 
+#define LOG_MODULE          "power"
+
+
 #define GPIO_PI_HAS_3V3     11
 #define GPIO_DCDC_ENABLE    12
 #define GPIO_PI_POWER_CTRL  13
@@ -57,35 +60,6 @@ bool vin_recoverable = false;
 uint8_t action_reason = 0;
 
 
-static uint8_t power_get_valid_source_priority(void) {
-    uint8_t priority = conf_get(CONF_PS_PRIORITY);
-
-    if (priority == POWER_SOURCE_PRIORITY_VUSB || priority == POWER_SOURCE_PRIORITY_VIN) {
-        return priority;
-    }
-
-    debug_log("Invalid power source priority: %d, fallback to Vusb first.\n", priority);
-    conf_set(CONF_PS_PRIORITY, POWER_SOURCE_PRIORITY_VUSB);
-    return POWER_SOURCE_PRIORITY_VUSB;
-}
-
-
-static bool power_is_vin_hot_standby_enabled(void) {
-    uint8_t value = conf_get(CONF_VIN_HOT_STANDBY);
-
-    if (value == 0) {
-        return false;
-    }
-    if (value == 1) {
-        return true;
-    }
-
-    debug_log("Invalid VIN_HOT_STANDBY: %d, fallback to 0.\n", value);
-    conf_set(CONF_VIN_HOT_STANDBY, 0);
-    return false;
-}
-
-
 static void power_ensure_dcdc_enabled(void) {
     if (gpio_get(GPIO_DCDC_ENABLE) == false) {
         gpio_put(GPIO_DCDC_ENABLE, true);
@@ -95,7 +69,7 @@ static void power_ensure_dcdc_enabled(void) {
 
 
 static void power_update_dcdc_for_vusb_mode(void) {
-    if (!power_is_vin_hot_standby_enabled()) {
+    if (!conf_get(CONF_VIN_HOT_STANDBY)) {
         gpio_put(GPIO_DCDC_ENABLE, false);
         return;
     }
@@ -113,7 +87,7 @@ static void power_update_dcdc_for_vusb_mode(void) {
 // Callback when system up timeout
 int64_t system_up_timeout_callback(alarm_id_t id, void *user_data) {
 	control_led(false, 0);
-    debug_log("Switch to ON state.\n");
+    log_info("Switch to ON state.\n");
     current_rpi_state = STATE_ON;
     system_up_alarm_id = -1;
     return 0;
@@ -132,11 +106,11 @@ int64_t heartbeat_missed_callback(alarm_id_t id, void *user_data) {
 
     heartbeat_missing_count++;
     
-    debug_log("Heartbeat is missed (%d/%d).\n", heartbeat_missing_count, allowed);
+    log_warn("Heartbeat is missed (%d/%d).\n", heartbeat_missing_count, allowed);
     
     if (heartbeat_missing_count > allowed) {
 
-        debug_log("Missing too many heartbeats: power cycle is required.\n");
+        log_error("Missing too many heartbeats: power cycle is required.\n");
 
         request_shutdown(true, ACTION_REASON_MISSED_HEARTBEAT); // Make a power cycle
 
@@ -205,7 +179,7 @@ void power_init(void) {
     gpio_put(GPIO_PI_POWER_CTRL, false);
     
     // Turn on DC/DC converter, if VIN has priority
-    gpio_put(GPIO_DCDC_ENABLE, power_get_valid_source_priority() == POWER_SOURCE_PRIORITY_VIN);
+    gpio_put(GPIO_DCDC_ENABLE, conf_get(CONF_PS_PRIORITY) == POWER_SOURCE_PRIORITY_VIN);
 	
 	schedule_rpi_off_intermittent_task();
 }
@@ -221,10 +195,10 @@ void power_init(void) {
 bool power_control_pi_power(bool on) {
     if (on) {   // Try to power Raspberry Pi
         if (gpio_get(GPIO_PI_POWER_CTRL) == true) {
-            debug_log("Can not turn on: Pi power is already on.\n");
+            log_warn("Can not turn on: Pi power is already on.\n");
             return false;
         }
-        uint8_t priority = power_get_valid_source_priority();
+        uint8_t priority = conf_get(CONF_PS_PRIORITY);
         if (priority == POWER_SOURCE_PRIORITY_VUSB) {   // VUSB has priority
             uint16_t vusb = get_vusb_mv();
             if (vusb >= MIN_VUSB_MV) {  // Vusb is high enough
@@ -233,7 +207,7 @@ bool power_control_pi_power(bool on) {
                 power_mode = POWER_MODE_VUSB;
                 current_rpi_state = STATE_STARTING;
                 reset_heatbeat_checking_timer();
-                debug_log("Raspberry Pi is powered by Vusb (%dmV).\n", vusb);
+                log_info("Raspberry Pi is powered by Vusb (%dmV).\n", vusb);
                 return true;
             } else {  // Vusb is too low
                 uint16_t vin = get_vin_mv();
@@ -241,14 +215,14 @@ bool power_control_pi_power(bool on) {
                     power_ensure_dcdc_enabled();
                     gpio_put(GPIO_PI_POWER_CTRL, true);
                     current_rpi_state = STATE_STARTING;
-                    debug_log("Raspberry Pi is powered by Vin (%dmV).\n", vin);
+                    log_info("Raspberry Pi is powered by Vin (%dmV).\n", vin);
 					power_mode = POWER_MODE_VIN;
                     reset_heatbeat_checking_timer();
                     return true;
     
                 } else {    // Vin is also too low
 					power_mode = POWER_MODE_NONE;
-                    debug_log("Voltage is too low to power Raspberry Pi: Vusb=%dmV, Vin=%dmV\n", vusb, vin);
+                    log_error("Voltage is too low to power Raspberry Pi: Vusb=%dmV, Vin=%dmV\n", vusb, vin);
                     return false;
                 }
             }
@@ -261,7 +235,7 @@ bool power_control_pi_power(bool on) {
 				power_mode = POWER_MODE_VIN;
 				current_rpi_state = STATE_STARTING;
 				reset_heatbeat_checking_timer();
-				debug_log("Raspberry Pi is powered by Vin (%dmV).\n", vin);
+				log_info("Raspberry Pi is powered by Vin (%dmV).\n", vin);
 				return true;
 			} else {	// Vin is too low
 				uint16_t vusb = get_vusb_mv();
@@ -270,30 +244,30 @@ bool power_control_pi_power(bool on) {
 					power_mode = POWER_MODE_VUSB;
 					current_rpi_state = STATE_STARTING;
 					reset_heatbeat_checking_timer();
-					debug_log("Raspberry Pi is powered by Vusb (%dmV).\n", vusb);
+					log_info("Raspberry Pi is powered by Vusb (%dmV).\n", vusb);
 					return true;
 				} else {	// Vusb is also too low
 					power_mode = POWER_MODE_NONE;
-                    debug_log("Voltage is too low to power Raspberry Pi: Vin=%dmV, Vusb=%dmV\n", vin, vusb);
+                    log_error("Voltage is too low to power Raspberry Pi: Vin=%dmV, Vusb=%dmV\n", vin, vusb);
                     return false;
 				}
 			}
         } else {
 			power_mode = POWER_MODE_NONE;
-            debug_log("Unkown power source priority: %d\n", priority);
+            log_error("Unkown power source priority: %d\n", priority);
             return false;
         }
     } else {    // Try to cut Raspberry Pi's power
         if (gpio_get(GPIO_PI_POWER_CTRL) == false) {
-            debug_log("Can not cut power: Pi is not powered.\n");
+            log_warn("Can not cut power: Pi is not powered.\n");
             return false;
         }
 		request_rpi_shutdown(false);
         gpio_put(GPIO_PI_POWER_CTRL, false);
-		gpio_put(GPIO_DCDC_ENABLE, power_get_valid_source_priority() == POWER_SOURCE_PRIORITY_VIN);
+		gpio_put(GPIO_DCDC_ENABLE, conf_get(CONF_PS_PRIORITY) == POWER_SOURCE_PRIORITY_VIN);
 		power_mode = POWER_MODE_NONE;
         current_rpi_state = STATE_OFF;
-        debug_log("Switch to OFF state.\n");
+        log_info("Switch to OFF state.\n");
         schedule_rpi_off_intermittent_task();
         if (power_cut_callback) {
             power_cut_callback();
@@ -334,10 +308,10 @@ bool request_startup(uint8_t reason) {
 		cancel_alarm(rpi_off_intermittent_task_alarm_id);
 		control_led(true, 0);
 
-        debug_log("Switch to STARTING state.\n");
+        log_info("Switch to STARTING state.\n");
         bool powered = power_control_pi_power(true);
         if (!powered) {
-            debug_log("Powering Raspberry Pi failed.\n");
+            log_error("Powering Raspberry Pi failed.\n");
             control_led(false, 0);
             schedule_rpi_off_intermittent_task();
             return false;
@@ -353,10 +327,10 @@ bool request_startup(uint8_t reason) {
 			load_and_schedule_alarm(false);
 		}
     } else if (current_rpi_state == STATE_ON) {
-        debug_log("Current state is already ON state.\n");
+        log_info("Current state is already ON state.\n");
         gpio_put(GPIO_PI_POWER_CTRL, true);
     } else {
-        debug_log("Can not request startup at this state: %d\n", current_rpi_state);
+        log_warn("Can not request startup at this state: %d\n", current_rpi_state);
         return false;
     }
     return true;
@@ -367,14 +341,14 @@ void restart_after_power_cut(void) {
     power_cut_callback = NULL;
     cancel_alarm(rpi_off_intermittent_task_alarm_id);
     sleep_us(POWER_CYCLE_INTERVAL_US);
-    debug_log("Restart as previously requested.\n");
+    log_info("Restart as previously requested.\n");
     request_startup(ACTION_REASON_REBOOT);
 }
 
 
 int64_t power_off_callback(alarm_id_t id, void *user_data) {
 	control_led(false, 0);
-    debug_log("Cut Raspberry Pi's power.\n");
+    log_info("Cut Raspberry Pi's power.\n");
     power_control_pi_power(false);
     power_off_alarm_id = -1;
     return 0;
@@ -399,7 +373,7 @@ bool request_shutdown(bool restart, uint8_t reason) {
         
 		request_rpi_shutdown(true);
 		control_led(true, 0);
-        debug_log("Switch to STOPPING state.\n");
+        log_info("Switch to STOPPING state.\n");
         current_rpi_state = STATE_STOPPING;
         power_cut_callback = restart ? restart_after_power_cut : NULL;
 		uint64_t delay = (uint64_t)conf_get(CONF_POWER_CUT_DELAY) * 1000000;
@@ -411,10 +385,10 @@ bool request_shutdown(bool restart, uint8_t reason) {
     	    }
 	    }
     } else if (current_rpi_state == STATE_OFF) {
-        debug_log("Current state is already OFF state.\n");
+        log_info("Current state is already OFF state.\n");
         gpio_put(GPIO_PI_POWER_CTRL, false);
     } else if (current_rpi_state != STATE_STOPPING) {   // Software may inform the shutdown/reboot when state is STATE_STOPPING
-        debug_log("Can not request shutdown at this state: %d\n", current_rpi_state);
+        log_warn("Can not request shutdown at this state: %d\n", current_rpi_state);
         return false;
     }
     return true;
@@ -458,7 +432,7 @@ uint8_t rpi_off_intermittent_task(void) {
  */
 int power_source_polling(void) {
     
-	uint8_t priority = power_get_valid_source_priority();
+	uint8_t priority = conf_get(CONF_PS_PRIORITY);
 	
 	if (gpio_get(GPIO_PI_POWER_CTRL) == true) {     // Raspberry Pi is powered
 		
@@ -487,7 +461,7 @@ int power_source_polling(void) {
                 power_low_counter ++;
                 if (power_low_counter > MAX_POWER_LOW_COUNTER) {
                     vin_recoverable = true;
-                    debug_log("Power low: Vusb=%dmV, Vin=%dmV, Vlow=%dmV\n", vusb, vin, vlow);
+                    log_warn("Power low: Vusb=%dmV, Vin=%dmV, Vlow=%dmV\n", vusb, vin, vlow);
                     request_shutdown(false, ACTION_REASON_VIN_DROP);
                     return POWER_LOW_SHUTDOWN;
                 }
@@ -510,7 +484,7 @@ int power_source_polling(void) {
 				    power_low_counter ++;
 				    if (power_low_counter > MAX_POWER_LOW_COUNTER) {
 				        vin_recoverable = true;
-    					debug_log("Power low: Vin=%dmV, Vlow=%dmV\n", vin, vlow);
+    					log_warn("Power low: Vin=%dmV, Vlow=%dmV\n", vin, vlow);
     					request_shutdown(false, ACTION_REASON_VIN_DROP);
     					return POWER_LOW_SHUTDOWN;
 				    }
@@ -526,7 +500,7 @@ int power_source_polling(void) {
 		power_mode = POWER_MODE_NONE;
 		
 		if (can_vin_turn_on_rpi() && !can_cur_time_turn_off_rpi() && !can_temperature_turn_off_rpi()) {
-		    debug_log("Startup occurs due to high Vin.\n");
+		    log_info("Startup occurs due to high Vin.\n");
 			request_startup(ACTION_REASON_VIN_RECOVER);
 			return POWER_RECOVER_STARTUP;
 		}
@@ -549,7 +523,7 @@ bool can_vin_turn_on_rpi(void) {
     	if (vrec != 0) {
     		uint16_t vin = get_vin_mv();
     		if (vin >= vrec) {
-    			debug_log("Vin=%dmV, Vrec=%dmV\n", vin, vrec);
+    			log_debug("Vin=%dmV, Vrec=%dmV\n", vin, vrec);
     			return true;
     		}
     	}
@@ -570,7 +544,7 @@ bool can_vin_turn_off_rpi(void) {
 		if (vlow != 0) {
 			uint16_t vin = get_vin_mv();
 			if (vin < vlow) {
-				debug_log("Vin=%dmV, Vlow=%dmV\n", vin, vlow);
+				log_debug("Vin=%dmV, Vlow=%dmV\n", vin, vlow);
 				return true;
 			}
 		}
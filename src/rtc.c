@@ -13,6 +13,9 @@
 #include "script.h"
 
 
+#define LOG_MODULE          "rtc"
+
+
 #define SYNC_TIME_INTERVAL_US      30000000
 
 #define RTC_ALARM_CONF_APPLY_DELAY_MS   100u
@@ -77,8 +80,6 @@ static uint8_t alarm_type = ALARM_TYPE_NONE;
 
 gpio_event_callback_t rtc_alarm_callback = NULL;
 
-const uint8_t days_in_month[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-
 alarm_id_t sync_timer_alarm_id = -1;
 
 static bool alarm1_conf_changed_pending = false;
@@ -106,126 +107,6 @@ static inline int8_t get_weekday(uint8_t wbits) {
 }
 
 
-/**
- * Check if given year is leap year
- * 
- * @param year The year
- * @return true if the year is a leap year, false otherwise
- */
-bool is_leap_year(int year) {
-    return ((year % 4 == 0 && year % 100 != 0) || (year % 400 == 0));
-}
-
-
-/**
- * Get the number of days in given month
- * 
- * @param year The year of the month
- * @param month The month (1~12)
- * @return The number of days in the month
- */
-int get_days_in_month(int year, int month) {
-    if (month == 2 && is_leap_year(year)) {
-        return 29;
-    }
-    return days_in_month[month];
-}
-
-
-/**
- * Convert DateTime to timestamp
- * 
- * @param dt Pointer to DateTime struct
- * @return The timestamp (total seconds since year 2000)
- */
-int64_t get_total_seconds(DateTime *dt) {
-    int64_t sec = 0;
-    // Add years contribution
-    for (int y = 2000; y < dt->year; y++) {
-        sec += (is_leap_year(y) ? 366 : 365) * 86400LL;
-    }
-    // Add months contribution
-    for (int m = 1; m < dt->month; m++) {
-        sec += get_days_in_month(dt->year, m) * 86400LL;
-    }
-    // Add days, hours, minutes, seconds
-    sec += (dt->day - 1) * 86400LL + dt->hour * 3600LL + dt->min * 60LL + dt->sec;
-    return sec;
-}
-
-
-/**
- * Convert timestamp to DateTime
- * 
- * @param timestamp The timestamp (total seconds since year 2000)
- * @param dt Pointer to DateTime struct
- * @return true if converted successful, false otherwise
- */
-void timestamp_to_datetime(int64_t timestamp, DateTime *dt) {
-    int64_t seconds_remaining = timestamp;
-    
-    // Set initial values
-    dt->year = 2000;
-    dt->month = 1;
-    dt->day = 1;
-    dt->hour = 0;
-    dt->min = 0;
-    dt->sec = 0;
-    dt->wday = 6;
-    
-    // Calculate year
-    while (true) {
-        int days_in_year = is_leap_year(dt->year) ? 366 : 365;
-        int64_t seconds_in_year = days_in_year * 86400LL;
-        
-        if (seconds_remaining < seconds_in_year)
-            break;
-            
-        seconds_remaining -= seconds_in_year;
-        dt->year++;
-    }
-    
-    // Calculate month
-    while (true) {
-        int days_in_current_month = get_days_in_month(dt->year, dt->month);
-        int64_t seconds_in_month = days_in_current_month * 86400LL;
-        
-        if (seconds_remaining < seconds_in_month)
-            break;
-            
-        seconds_remaining -= seconds_in_month;
-        dt->month++;
-    }
-    
-    // Calculate day
-    dt->day = 1 + (int)(seconds_remaining / 86400LL);
-    seconds_remaining %= 86400LL;
-    
-    // Calculate hour
-    dt->hour = (int)(seconds_remaining / 3600LL);
-    seconds_remaining %= 3600LL;
-    
-    // Calculate minute
-    dt->min = (int)(seconds_remaining / 60LL);
-    
-    // Calculate second
-    dt->sec = (int)(seconds_remaining % 60LL);
-    
-    // Calculate weekday using Zeller's algorithm
-    int y = dt->year;
-    int m = dt->month;
-    int d = dt->day;
-    if (m < 3) {
-        m += 12;
-        y--;
-    }
-    int k = y % 100;
-    int j = y / 100;
-    int h = (d + 13*(m+1)/5 + k + k/4 + j/4 + 5*j) % 7;
-    dt->wday = (h + 6) % 7;    
-}
-
-
 // Callback when RTC alarm occurs
 void rtc_alarm_occurred(void) {
     if (rtc_alarm_callback) {
@@ -252,7 +133,7 @@ static void rtc_apply_alarm1_conf(void) {
 	int minute = bcd_to_dec(conf_get(CONF_ALARM1_MINUTE));
 	int second = bcd_to_dec(conf_get(CONF_ALARM1_SECOND));
 	if (date < 1 || date > 31 || hour > 23 || minute > 59 || second > 59) {
-		debug_log("Clear Alarm1\n");
+		log_info("Clear Alarm1\n");
 		rtc_set_alarm(0, 0, 0, true);
 	} else {
 		DateTime dt;
@@ -261,7 +142,7 @@ static void rtc_apply_alarm1_conf(void) {
 		if (adjust_action_time_for_dst(&ts)) {
 			timestamp_to_datetime(ts, &dt);
 		}
-		debug_log("Set Alarm1 to %02d %02d:%02d\n", dt.day, dt.hour, dt.min);
+		log_info("Set Alarm1 to %02d %02d:%02d\n", dt.day, dt.hour, dt.min);
 		rtc_set_alarm(dt.day, dt.hour, dt.min, true);
 	}
 }
@@ -272,7 +153,7 @@ static void rtc_apply_alarm2_conf(void) {
 	int minute = bcd_to_dec(conf_get(CONF_ALARM2_MINUTE));
 	int second = bcd_to_dec(conf_get(CONF_ALARM2_SECOND));
 	if (date < 1 || date > 31 || hour > 23 || minute > 59 || second > 59) {
-		debug_log("Clear Alarm2\n");
+		log_info("Clear Alarm2\n");
 		rtc_set_alarm(0, 0, 0, false);
 	} else {
 		DateTime dt;
@@ -281,19 +162,19 @@ static void rtc_apply_alarm2_conf(void) {
 		if (adjust_action_time_for_dst(&ts)) {
 			timestamp_to_datetime(ts, &dt);
 		}
-		debug_log("Set Alarm2 to %02d %02d:%02d\n", dt.day, dt.hour, dt.min);
+		log_info("Set Alarm2 to %02d %02d:%02d\n", dt.day, dt.hour, dt.min);
 		rtc_set_alarm(dt.day, dt.hour, dt.min, false);
 	}
 }
 
 // Extra processing after alarm configuration is changed
-void on_alarm_conf_changed(const char *key, uint8_t old_val, uint8_t new_val) {
+static void on_alarm_conf_changed(conf_key_t key, uint8_t old_val, uint8_t new_val) {
 	if (current_rpi_state == STATE_STOPPING || current_rpi_state == STATE_OFF) {
-		if (strcmp(key, CONF_ALARM1_MINUTE) == 0 || strcmp(key, CONF_ALARM1_HOUR) == 0 || strcmp(key, CONF_ALARM1_DAY) == 0) {
+		if (key == CONF_ALARM1_MINUTE || key == CONF_ALARM1_HOUR || key == CONF_ALARM1_DAY) {
 		   alarm1_conf_changed_pending = true;
 		}
 	} else if (current_rpi_state == STATE_STARTING || current_rpi_state == STATE_ON) {
-		if (strcmp(key, CONF_ALARM2_MINUTE) == 0 || strcmp(key, CONF_ALARM2_HOUR) == 0 || strcmp(key, CONF_ALARM2_DAY) == 0) {
+		if (key == CONF_ALARM2_MINUTE || key == CONF_ALARM2_HOUR || key == CONF_ALARM2_DAY) {
             alarm2_conf_changed_pending = true;
 		}
 	}
@@ -336,14 +217,7 @@ void rtc_init(gpio_event_callback_t callback) {
 	
 	add_alarm_in_us(SYNC_TIME_INTERVAL_US, sync_time_callback, NULL, true);
 	
-	register_item_changed_callback(CONF_ALARM1_SECOND, on_alarm_conf_changed);
-	register_item_changed_callback(CONF_ALARM1_MINUTE, on_alarm_conf_changed);
-	register_item_changed_callback(CONF_ALARM1_HOUR, on_alarm_conf_changed);
-	register_item_changed_callback(CONF_ALARM1_DAY, on_alarm_conf_changed);
-	register_item_changed_callback(CONF_ALARM2_SECOND, on_alarm_conf_changed);
-	register_item_changed_callback(CONF_ALARM2_MINUTE, on_alarm_conf_changed);
-	register_item_changed_callback(CONF_ALARM2_HOUR, on_alarm_conf_changed);
-	register_item_changed_callback(CONF_ALARM2_DAY, on_alarm_conf_changed);
+	conf_subscribe(CONF_ALARM1_SECOND, CONF_ALARM2_DAY, on_alarm_conf_changed);
 }
 
 
@@ -751,7 +625,7 @@ bool apply_dst_if_needed(void) {
                 // Begin DST: set clocks forward
 				rtc_set_timestamp(cur_ts + offset);
 				conf_set(CONF_DST_APPLIED, 1);
-				conf_sync();
+				conf_save_binary();
                 return true;
             }
         } else {
@@ -759,7 +633,7 @@ bool apply_dst_if_needed(void) {
                 // End DST: set clocks backward
 				rtc_set_timestamp(cur_ts - offset);
 				conf_set(CONF_DST_APPLIED, 0);
-				conf_sync();
+				conf_save_binary();
                 return true;
             }
         }
@@ -840,7 +714,7 @@ bool load_and_schedule_alarm(bool startup) {
         rtc_set_alarm(dt.day, dt.hour, dt.min, startup);
     } else {
         rtc_set_alarm(day, hour, min, startup);
-        debug_log("Set Alarm %02d %02d:%02d for %s\n",
+        log_info("Set Alarm %02d %02d:%02d for %s\n",
                   day, hour, min, startup ? "startup" : "shutdown");
     }
 
@@ -12,6 +12,9 @@
 #include "util.h"
 
 
+#define LOG_MODULE          "script"
+
+
 #define WPI_SCRIPT_STATE_ON		0
 #define WPI_SCRIPT_STATE_OFF	1
 #define WPI_MAX_LINES 			128
@@ -128,7 +131,7 @@ bool parse_wpi_script(const char* script_text, Action* actions, int* num_actions
         next_line = strchr(line_start, '\n');
         size_t line_length = next_line ? (next_line - line_start) : strlen(line_start);
         if (line_length >= WPI_MAX_LINE_LENGTH) {
-            debug_log("Error: Line too long\n");
+            log_error("Line too long\n");
             return false;
         }
         strncpy(line_buffer, line_start, line_length);
@@ -188,7 +191,7 @@ bool parse_wpi_script(const char* script_text, Action* actions, int* num_actions
                     // Extract token to buffer
                     size_t token_len = token_end - token_start;
                     if (token_len >= WPI_MAX_LINE_LENGTH) {
-                        debug_log("Error: Token too long\n");
+                        log_error("Token too long\n");
                         return false;
                     }
                     
@@ -196,7 +199,7 @@ bool parse_wpi_script(const char* script_text, Action* actions, int* num_actions
                     token_buffer[token_len] = '\0';
                     
                     if (!parse_time_component(token_buffer, &hours, &minutes, &seconds)) {
-                        debug_log("Error: Invalid time component '%s'\n", token_buffer);
+                        log_error("Invalid time component '%s'\n", token_buffer);
                         return false;
                     }
                     
@@ -211,7 +214,7 @@ bool parse_wpi_script(const char* script_text, Action* actions, int* num_actions
                 if (state_count < WPI_MAX_LINES) {
                     states[state_count++] = state;
                 } else {
-                    debug_log("Error: Too many states defined\n");
+                    log_error("Too many states defined\n");
                     return false;
                 }
             }
@@ -227,7 +230,7 @@ bool parse_wpi_script(const char* script_text, Action* actions, int* num_actions
     
     // Check if the script is good
     if (!begin_found || !end_found || state_count == 0) {
-        debug_log("Error: Missing required BEGIN, END or state definitions\n");
+        log_error("Missing required BEGIN, END or state definitions\n");
         return false;
     }
 
@@ -275,12 +278,21 @@ bool parse_wpi_script(const char* script_text, Action* actions, int* num_actions
         }
     }
     if (*num_actions >= WPI_MAX_ACTIONS - 1) {
-        debug_log("Warning: action list is truncated.\n");
+        log_warn("action list is truncated.\n");
     }
     return true;
 }
 
 
+// Save alarm of action to configuration, all items are set at once so the alarm is never partially updated
+static void save_action_alarm(bool is_up, DateTime *dt) {
+    static const conf_key_t alarm1_keys[] = {CONF_ALARM1_SECOND, CONF_ALARM1_MINUTE, CONF_ALARM1_HOUR, CONF_ALARM1_DAY};
+    static const conf_key_t alarm2_keys[] = {CONF_ALARM2_SECOND, CONF_ALARM2_MINUTE, CONF_ALARM2_HOUR, CONF_ALARM2_DAY};
+    uint8_t values[] = {dec_to_bcd(dt->sec), dec_to_bcd(dt->min), dec_to_bcd(dt->hour), dec_to_bcd(dt->day)};
+    conf_set_batch(is_up ? alarm1_keys : alarm2_keys, values, 4);
+}
+
+
 // Save action/alarm to configuration
 bool configure_action(Action * action) {
     if(!action) {
@@ -289,17 +301,7 @@ bool configure_action(Action * action) {
     DateTime dt;
 	timestamp_to_datetime(action->time, &dt);
 	
-    if (action->is_up) {
-        conf_set(CONF_ALARM1_SECOND, dec_to_bcd(dt.sec));
-        conf_set(CONF_ALARM1_MINUTE, dec_to_bcd(dt.min));
-        conf_set(CONF_ALARM1_HOUR, dec_to_bcd(dt.hour));
-        conf_set(CONF_ALARM1_DAY, dec_to_bcd(dt.day));
-    } else {
-        conf_set(CONF_ALARM2_SECOND, dec_to_bcd(dt.sec));
-        conf_set(CONF_ALARM2_MINUTE, dec_to_bcd(dt.min));
-        conf_set(CONF_ALARM2_HOUR, dec_to_bcd(dt.hour));
-        conf_set(CONF_ALARM2_DAY, dec_to_bcd(dt.day));
-    }
+    save_action_alarm(action->is_up, &dt);
     return true;
 }
 
@@ -311,19 +313,9 @@ bool set_alarm_for_action(Action * action) {
     }
     DateTime dt;
 	timestamp_to_datetime(action->time, &dt);
-	debug_log("%s is scheduled to: %d-%02d-%02d %02d:%02d:%02d\n", action->is_up ? "Startup" : "Shutdown", dt.year, dt.month, dt.day, dt.hour, dt.min, dt.sec);
+	log_info("%s is scheduled to: %d-%02d-%02d %02d:%02d:%02d\n", action->is_up ? "Startup" : "Shutdown", dt.year, dt.month, dt.day, dt.hour, dt.min, dt.sec);
 
-    if (action->is_up) {
-        conf_set(CONF_ALARM1_SECOND, dec_to_bcd(dt.sec));
-        conf_set(CONF_ALARM1_MINUTE, dec_to_bcd(dt.min));
-        conf_set(CONF_ALARM1_HOUR, dec_to_bcd(dt.hour));
-        conf_set(CONF_ALARM1_DAY, dec_to_bcd(dt.day));
-    } else {
-        conf_set(CONF_ALARM2_SECOND, dec_to_bcd(dt.sec));
-        conf_set(CONF_ALARM2_MINUTE, dec_to_bcd(dt.min));
-        conf_set(CONF_ALARM2_HOUR, dec_to_bcd(dt.hour));
-        conf_set(CONF_ALARM2_DAY, dec_to_bcd(dt.day));
-    }
+    save_action_alarm(action->is_up, &dt);
 
     return true;
 }
@@ -699,33 +691,33 @@ bool load_script(bool run) {
     bool valid;
     uint64_t cur_time = rtc_get_timestamp(&valid);
     if (!valid) {
-        debug_log("Current time is invalid, skip schedule script.\n");
+        log_warn("Current time is invalid, skip schedule script.\n");
         return false;
     }
     
     if (!file_exists(SKD_SCRIPT_PATH)) {
         if (file_exists(ACT_SCRIPT_PATH)) {
             if (convert_act_to_skd(ACT_SCRIPT_PATH, SKD_SCRIPT_PATH)) {
-                debug_log("Generated .skd file from .act file\n");
+                log_info("Generated .skd file from .act file\n");
             } else {
-                debug_log("Failed to generate .skd file from .act file\n");
+                log_error("Failed to generate .skd file from .act file\n");
                 return false;
             }
         } else if (file_exists(WPI_SCRIPT_PATH)) {
             if (convert_wpi_to_act(WPI_SCRIPT_PATH, ACT_SCRIPT_PATH, cur_time)) {
-                debug_log("Generated .act file from .wpi file\n");
+                log_info("Generated .act file from .wpi file\n");
             } else {
-                debug_log("Failed to generate .act file from .wpi file\n");
+                log_error("Failed to generate .act file from .wpi file\n");
                 return false;
             }
             if (convert_act_to_skd(ACT_SCRIPT_PATH, SKD_SCRIPT_PATH)) {
-                debug_log("Generated .skd file from .act file\n");
+                log_info("Generated .skd file from .act file\n");
             } else {
-                debug_log("Failed to generate .skd file from .act file\n");
+                log_error("Failed to generate .skd file from .act file\n");
                 return false;
             }
         } else {
-            debug_log("No schedule script is found.\n");
+            log_info("No schedule script is found.\n");
             return false;
         }
     }
@@ -744,13 +736,13 @@ bool load_script(bool run) {
     
     if (file_exists(SKD_SCRIPT_PATH)) {
         if (find_next_actions_from_skd(SKD_SCRIPT_PATH, cur_time, startup_first, &startup, &shutdown)) {
-            debug_log("Found future actions from %s\n", SKD_SCRIPT_PATH);
+            log_info("Found future actions from %s\n", SKD_SCRIPT_PATH);
         } else {
-            debug_log("No future action is found in script.\n");
+            log_warn("No future action is found in script.\n");
             return false;
         }
     } else {
-        debug_log("The file %s is not found.\n", SKD_SCRIPT_PATH);
+        log_warn("The file %s is not found.\n", SKD_SCRIPT_PATH);
         return false;
     }
     
@@ -758,21 +750,21 @@ bool load_script(bool run) {
     if (startup_first) {
 		adjust_action_time_for_dst(&startup.time);
         if (!set_alarm_for_action(&startup)) {
-            debug_log("Can not set alarm for startup action.\n");
+            log_error("Can not set alarm for startup action.\n");
             success = false;
         }
         if (!configure_action(&shutdown)) {
-            debug_log("Can not configure shutdown action.\n");
+            log_error("Can not configure shutdown action.\n");
             success = false;
         }
     } else {
 		adjust_action_time_for_dst(&shutdown.time);
         if (!set_alarm_for_action(&shutdown)) {
-            debug_log("Can not set alarm for shutdown action.\n");
+            log_error("Can not set alarm for shutdown action.\n");
             success = false;
         }
         if (!configure_action(&startup)) {
-            debug_log("Can not configure startup action.\n");
+            log_error("Can not configure startup action.\n");
             success = false;
         }
     }
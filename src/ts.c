@@ -9,6 +9,9 @@
 #include "conf.h"
 
 
+#define LOG_MODULE          "ts"
+
+
 #define SMBUS_ALERT_RESPONSE_ADDRESS    0x0C
 
 // Alert status (seems opposite with section 7.3.2.5 in TMP112 datasheet)
@@ -44,7 +47,7 @@ void ts_process_alert(void) {
         status = get_smbus_alert_status();
     }
     if (status == -1) {
-        debug_log("Received alert without status.\n");
+        log_info("Received alert without status.\n");
         return; // Ignore alert without smbus response
     }
 
@@ -53,7 +56,7 @@ void ts_process_alert(void) {
     int32_t t_low = ts_get_t_low_mc();
     int32_t t_high = ts_get_t_high_mc();
     gpio_set_input_enabled(GPIO_TS_INT, false);
-    debug_log("t=%d, t_low=%d, t_high=%d, status=%d\n", t, t_low, t_high, status);
+    log_debug("t=%d, t_low=%d, t_high=%d, status=%d\n", t, t_low, t_high, status);
     gpio_set_input_enabled(GPIO_TS_INT, true);
 
     // Invoke callback according to alert status
@@ -66,16 +69,16 @@ void ts_process_alert(void) {
             below_callback();
         }
     } else {
-        debug_log("Unknown alert status: %d\n", status);
+        log_error("Unknown alert status: %d\n", status);
     }
 }
 
 
 // Extra processing after configuration is changed
-void on_temp_point_conf_changed(const char *key, uint8_t old_val, uint8_t new_val) {
-	if (strcmp(key, CONF_BELOW_TEMP_POINT) == 0) {
+static void on_temp_point_conf_changed(conf_key_t key, uint8_t old_val, uint8_t new_val) {
+	if (key == CONF_BELOW_TEMP_POINT) {
 		ts_set_t_low_mc((int32_t)new_val * 1000);
-	} else if (strcmp(key, CONF_OVER_TEMP_POINT) == 0) {
+	} else if (key == CONF_OVER_TEMP_POINT) {
 		ts_set_t_high_mc((int32_t)new_val * 1000);
 	}
 }
@@ -100,10 +103,10 @@ void ts_init(gpio_event_callback_t below, gpio_event_callback_t over) {
     gpio_register_callback(GPIO_TS_INT, GPIO_IRQ_EDGE_FALL, ts_process_alert);
 
 	ts_set_t_low_mc((int32_t)conf_get(CONF_BELOW_TEMP_POINT) * 1000);
-	register_item_changed_callback(CONF_BELOW_TEMP_POINT, on_temp_point_conf_changed);
+	conf_subscribe(CONF_BELOW_TEMP_POINT, CONF_BELOW_TEMP_POINT, on_temp_point_conf_changed);
 
 	ts_set_t_high_mc((int32_t)conf_get(CONF_OVER_TEMP_POINT) * 1000);
-	register_item_changed_callback(CONF_OVER_TEMP_POINT, on_temp_point_conf_changed);
+	conf_subscribe(CONF_OVER_TEMP_POINT, CONF_OVER_TEMP_POINT, on_temp_point_conf_changed);
 }
 
 
@@ -12,8 +12,13 @@
 #include "util.h"
 #include "usb_msc_device.h"
 
+
+#define LOG_MODULE          "usb"
+
 #define VERSION_STR TO_STRING(FIRMWARE_VERSION_MAJOR) "." TO_STRING(FIRMWARE_VERSION_MINOR)
 
+#define SCSI_CMD_SYNCHRONIZE_CACHE_10   0x35
+
 
 static bool ejected = false;
 
@@ -85,7 +90,10 @@ bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, boo
         bool was_ejected = ejected;
         ejected = !start;
         if (ejected != was_ejected) {
-            debug_log("Eject USB MSC device.\n");
+            log_info("Eject USB MSC device.\n");
+
+            // Write cached sectors into flash
+            flash_fatfs_flush(true);
 
             // Generate script files if necessary
             load_script(false);
@@ -102,7 +110,7 @@ bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, boo
 int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize) {
     (void) lun;
     if (lba >= FAT_BLOCK_NUM) {
-        debug_log("read10 out of ramdisk: lba=%u\n", lba);
+        log_error("read10 out of ramdisk: lba=%u\n", lba);
         return -1;
     }
     flash_fatfs_read(lba, buffer, bufsize);
@@ -124,7 +132,11 @@ bool tud_msc_is_writable_cb (uint8_t lun) {
  * Invoked when command in tud_msc_scsi_cb is complete
  */
 void tud_msc_scsi_complete_cb(uint8_t lun, uint8_t const scsi_cmd[16]) {
-
+    (void) lun;
+    if (scsi_cmd[0] == SCSI_CMD_SYNCHRONIZE_CACHE_10) {
+        // Commit partially written sectors
+        flash_fatfs_flush(true);
+    }
 }
 
 
@@ -145,11 +157,10 @@ int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t*
     }
 
     if (is_fatfs_mounted()) {
-        unmount_fatfs();  // unmount the FS
-        mount_fatfs();    // mount the FS again
+        invalidate_fatfs();  // FS will be mounted again when firmware uses it
     }
 
-    flash_fatfs_write(lba, buffer, bufsize);
+    flash_fatfs_host_write(lba, buffer, bufsize);
 
     return (int32_t)bufsize;
 }
@@ -168,6 +179,10 @@ int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void* buffer, u
     bool in_xfer = true;
 
     switch (scsi_cmd[0]) {
+    case SCSI_CMD_SYNCHRONIZE_CACHE_10:
+        // Sectors will be written when the command is complete
+        resplen = 0;
+        break;
     default:
         // Set Sense = Invalid Command Operation
         tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
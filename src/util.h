@@ -1,6 +1,9 @@
 #ifndef _UTIL_H_
 #define _UTIL_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #define STRINGIFY(x) #x
 #define TO_STRING(x) STRINGIFY(x)
 
@@ -28,4 +31,23 @@ static inline uint8_t dec_to_bcd(uint8_t dec) {
 }
 
 
+/**
+ * Calculate CRC-32 (IEEE 802.3) over data
+ * 
+ * @param data Pointer to data
+ * @param len Length of data
+ * @return The CRC-32 value
+ */
+static inline uint32_t crc32(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+// Replacements of firmware modules that are not built on host (RTC, LED, I2C, USB)
+
+#include <time.h>
+#include <hardware/powman.h>
+#include "flash_sim.h"
+#include "rtc.h"
+#include "main.h"
+#include "led.h"
+#include "i2c.h"
+#include "usb_msc_device.h"
+
+
+#define BENCH_EPOCH_MS      1735689600000ULL     // 2025-01-01 00:00:00
+
+
+uint8_t current_rpi_state = STATE_OFF;
+
+
+uint64_t powman_timer_get_ms(void) {
+    return BENCH_EPOCH_MS + sim_time_us / 1000;
+}
+
+
+int64_t get_total_seconds(DateTime *dt) {
+    struct tm tm = {
+        .tm_year = dt->year - 1900,
+        .tm_mon = dt->month - 1,
+        .tm_mday = dt->day,
+        .tm_hour = dt->hour,
+        .tm_min = dt->min,
+        .tm_sec = dt->sec,
+    };
+    return (int64_t)timegm(&tm) - TIMESTAMP_2000_01_01;
+}
+
+
+void timestamp_to_datetime(int64_t timestamp, DateTime *dt) {
+    time_t t = (time_t)(timestamp + TIMESTAMP_2000_01_01);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    dt->year = tm.tm_year + 1900;
+    dt->month = tm.tm_mon + 1;
+    dt->day = tm.tm_mday;
+    dt->hour = tm.tm_hour;
+    dt->min = tm.tm_min;
+    dt->sec = tm.tm_sec;
+    dt->wday = tm.tm_wday;
+}
+
+
+int64_t rtc_get_timestamp(bool *valid) {
+    if (valid) {
+        *valid = true;
+    }
+    return powman_timer_get_ms() / 1000 - TIMESTAMP_2000_01_01;
+}
+
+
+bool adjust_action_time_for_dst(uint64_t *p_action_ts) {
+    (void)p_action_ts;
+    return false;
+}
+
+
+void log_current_rpi_state(void) {
+}
+
+
+void control_led(bool on, int duration) {
+    (void)on;
+    (void)duration;
+}
+
+
+uint32_t i2c_get_idle_time_us(void) {
+    return UINT32_MAX;  // Raspberry Pi never talks
+}
+
+
+bool is_usb_msc_device_mounted(void) {
+    return false;
+}
+
+
+void usb_msc_ensure_ejected(void) {
+}
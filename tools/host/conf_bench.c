@@ -0,0 +1,120 @@
+// Measure the cost of getting configuration values
+//
+// Random keys are looked up by comparing key strings over a list of items, as the firmware
+// used to do, and by conf_get() that reads the value array indexed by key. Both must give
+// the same values. conf_get() is taken unchanged from the firmware header.
+//
+// Usage: conf_bench [-n count]
+//   -n  number of lookups (default 10000000)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "conf.h"
+
+
+conf_obj_t config;
+
+
+// Items as the firmware used to keep them, in the order of key id
+typedef struct {
+    char key[CONF_MAX_KEY_LENGTH];
+    uint8_t value;
+    void *callback;
+} string_item_t;
+
+static const char *const key_names[CONF_COUNT] = {
+    "ADDRESS", "DEFAULT_ON_DELAY", "POWER_CUT_DELAY", "PULSE_INTERVAL", "BLINK_LED", "DUMMY_LOAD",
+    "LOW_VOLTAGE", "RECOVERY_VOLTAGE", "PS_PRIORITY", "ADJ_VUSB", "ADJ_VIN", "ADJ_VOUT", "ADJ_IOUT",
+    "WATCHDOG", "LOG_TO_FILE", "BOOTSEL_FTY_RST",
+    "ALARM1_SECOND", "ALARM1_MINUTE", "ALARM1_HOUR", "ALARM1_DAY",
+    "ALARM2_SECOND", "ALARM2_MINUTE", "ALARM2_HOUR", "ALARM2_DAY",
+    "BELOW_TEMP_ACTION", "BELOW_TEMP_POINT", "OVER_TEMP_ACTION", "OVER_TEMP_POINT",
+    "DST_OFFSET", "DST_BEGIN_MON", "DST_BEGIN_DAY", "DST_BEGIN_HOUR", "DST_BEGIN_MIN",
+    "DST_END_MON", "DST_END_DAY", "DST_END_HOUR", "DST_END_MIN", "DST_APPLIED",
+    "SYS_CLOCK_MHZ", "VIN_HOT_STANDBY", "LOG_FORMAT", "LOG_FILE_SIZE", "LOG_LEVEL",
+};
+
+static string_item_t string_items[CONF_MAX_ITEMS];
+static int string_count;
+
+
+static uint64_t cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// The firmware before the value array
+static __attribute__((noinline)) uint8_t conf_get_by_string(const char *key) {
+    for (int i = 0; i < string_count; i++) {
+        if (0 == strcmp(string_items[i].key, key)) {
+            return string_items[i].value;
+        }
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    int count = 10000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n': count = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-n count]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (count <= 0) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    srand(1);
+    for (int i = 0; i < CONF_COUNT; i++) {
+        config.values[i] = rand() & 0xFF;
+        strcpy(string_items[i].key, key_names[i]);
+        string_items[i].value = config.values[i];
+    }
+    string_count = CONF_COUNT;
+
+    conf_key_t *keys = malloc(sizeof(conf_key_t) * count);
+    if (!keys) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        keys[i] = (conf_key_t)(rand() % CONF_COUNT);
+    }
+
+    uint32_t string_sum = 0;
+    uint64_t start = cpu_ns();
+    for (int i = 0; i < count; i++) {
+        string_sum += conf_get_by_string(key_names[keys[i]]);
+    }
+    uint64_t string_ns = cpu_ns() - start;
+
+    uint32_t indexed_sum = 0;
+    start = cpu_ns();
+    for (int i = 0; i < count; i++) {
+        indexed_sum += conf_get(keys[i]);
+    }
+    uint64_t indexed_ns = cpu_ns() - start;
+
+    if (string_sum != indexed_sum) {
+        fprintf(stderr, "Mismatch: %u != %u\n", string_sum, indexed_sum);
+        return 1;
+    }
+
+    printf("%d lookups over %d items\n", count, CONF_COUNT);
+    printf("%-26s %11s %11s\n", "Method", "Total(ms)", "Each(ns)");
+    printf("%-26s %11.1f %11.2f\n", "key string compare", string_ns / 1e6, (double)string_ns / count);
+    printf("%-26s %11.1f %11.2f\n", "value array", indexed_ns / 1e6, (double)indexed_ns / count);
+    free(keys);
+    return 0;
+}
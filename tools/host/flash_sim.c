@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pico/stdlib.h>
+#include "flash_sim.h"
+
+
+uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+
+uint32_t sim_erase_count[SIM_FLASH_SECTORS];
+
+uint64_t sim_bytes_programmed = 0;
+
+uint64_t sim_time_us = 0;
+
+uint32_t sim_max_call_us = 0;
+
+stdio_driver_t stdio_usb;
+
+
+/**
+ * Fill the emulated flash with 0xFF and clear the counters
+ */
+void flash_sim_reset(void) {
+    memset(sim_flash, 0xFF, sizeof(sim_flash));
+    memset(sim_erase_count, 0, sizeof(sim_erase_count));
+    sim_bytes_programmed = 0;
+    sim_time_us = 0;
+    sim_max_call_us = 0;
+}
+
+
+// Advance the time by the duration of one erase or program call
+static void add_call_time(uint32_t duration) {
+    sim_time_us += duration;
+    if (duration > sim_max_call_us) {
+        sim_max_call_us = duration;
+    }
+}
+
+
+uint64_t time_us_64(void) {
+    return sim_time_us;
+}
+
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    if (flash_offs % FLASH_SECTOR_SIZE || count % FLASH_SECTOR_SIZE || flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        fprintf(stderr, "Invalid erase: offset=0x%X count=%zu\n", flash_offs, count);
+        abort();
+    }
+    memset(sim_flash + flash_offs, 0xFF, count);
+    for (size_t i = 0; i < count / FLASH_SECTOR_SIZE; i++) {
+        sim_erase_count[flash_offs / FLASH_SECTOR_SIZE + i]++;
+    }
+    add_call_time(count / FLASH_SECTOR_SIZE * SIM_SECTOR_ERASE_US);
+}
+
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    if (flash_offs % FLASH_PAGE_SIZE || count % FLASH_PAGE_SIZE || flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        fprintf(stderr, "Invalid program: offset=0x%X count=%zu\n", flash_offs, count);
+        abort();
+    }
+    // NOR flash can only clear bits
+    for (size_t i = 0; i < count; i++) {
+        sim_flash[flash_offs + i] &= data[i];
+    }
+    sim_bytes_programmed += count;
+    add_call_time(count / FLASH_PAGE_SIZE * SIM_PAGE_PROGRAM_US);
+}
@@ -0,0 +1,26 @@
+#ifndef _FLASH_SIM_H_
+#define _FLASH_SIM_H_
+
+#include <hardware/flash.h>
+
+#define SIM_FLASH_SECTORS   (PICO_FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE)
+
+extern uint32_t sim_erase_count[SIM_FLASH_SECTORS];
+
+extern uint64_t sim_bytes_programmed;
+
+extern uint64_t sim_time_us;
+
+extern uint32_t sim_max_call_us;    // Longest erase or program call, interrupts are disabled for it on target
+
+// Typical timing of the QSPI flash on Witty Pi 5
+#define SIM_SECTOR_ERASE_US     45000
+#define SIM_PAGE_PROGRAM_US     700
+
+
+/**
+ * Fill the emulated flash with 0xFF and clear the counters
+ */
+void flash_sim_reset(void);
+
+#endif
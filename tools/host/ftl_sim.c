@@ -0,0 +1,421 @@
+// Simulate a year of typical logging on the FAT volume and report the erase count of every flash sector
+//
+// The FAT12 volume is modelled at 4k sector level (one cluster per sector), in the same
+// layout as the one created by flash_fatfs_init(). Every log flush appends text to
+// /log/WittyPi5.log and writes back the touched data, FAT and directory sectors, like
+// f_close() does through the sector cache. The configuration file is rewritten once a day.
+//
+// Sectors that have to wait for an erased sector stay dirty, like in the sector cache,
+// and are forced out (erased in place if necessary) when more than the cache can hold.
+//
+// Usage: ftl_sim [-n] [-d days] [-i minutes] [-b bytes] [-c KB] [-g flushes] [-o file.csv]
+//   -n  write in place without FTL (the old behaviour), for comparison
+//   -d  number of simulated days (default 365)
+//   -i  log flush interval in minutes (default 10)
+//   -b  log bytes per flush (default 400)
+//   -c  log file size in KB before it gets deleted and restarted (default 1024)
+//   -g  background erasing only gets a chance after every N flushes, like when the Pi polls
+//       I2C faster than the idle time needed for it (default 1)
+//   -o  save erase count of every flash sector in FAT and tail area to CSV file
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "flash_sim.h"
+#include "ftl.h"
+
+
+#define BOOT_SECTOR         0
+#define FAT1_SECTOR         1
+#define FAT2_SECTOR         3
+#define FAT_SECTORS         2
+#define ROOT_DIR_SECTOR     5
+#define DATA_SECTOR         9   // Cluster 2
+
+#define LOG_DIR_CLUSTER     2
+#define CONF_DIR_CLUSTER    3
+#define FIRST_FREE_CLUSTER  4
+#define CLUSTER_NUM         (FTL_LOGICAL_SECTORS - DATA_SECTOR + 2)
+
+#define CONF_FILE_SIZE      1200
+
+#define CACHE_SECTORS       6   // FLASH_CACHE_SECTORS in flash.c
+
+
+typedef struct {
+    int dir_cluster;        // Cluster of the directory holding the entry
+    int entry_offset;       // Offset of the entry in directory sector
+    int first_cluster;
+    int last_cluster;
+    uint32_t size;
+} sim_file_t;
+
+
+static uint8_t (*image)[FLASH_SECTOR_SIZE];
+
+static bool dirty[FTL_LOGICAL_SECTORS];
+
+static bool use_ftl = true;
+
+static int alloc_hint = FIRST_FREE_CLUSTER;
+
+static uint32_t clock_minutes = 0;
+
+static uint64_t host_writes = 0;
+
+static uint64_t skipped_writes = 0;
+
+static uint64_t in_place_writes = 0;
+
+static uint64_t deferred_writes = 0;
+
+static uint64_t flush_erases = 0;
+
+static uint32_t max_flush_irq_off_us = 0;
+
+
+void debug_log(const char *fmt, ...) {
+    (void)fmt;
+}
+
+
+void log_message(uint8_t level, const char *fmt, ...) {
+    (void)level;
+    (void)fmt;
+}
+
+
+static int cluster_sector(int cluster) {
+    return DATA_SECTOR + cluster - 2;
+}
+
+
+static int fat_get(int cluster) {
+    uint8_t *fat = image[FAT1_SECTOR];
+    int offset = cluster + cluster / 2;
+    uint16_t v = fat[offset] | (fat[offset + 1] << 8);
+    return (cluster & 1) ? (v >> 4) : (v & 0xFFF);
+}
+
+
+static void fat_set(int cluster, int value) {
+    for (int copy = 0; copy < 2; copy++) {
+        int first = copy ? FAT2_SECTOR : FAT1_SECTOR;
+        uint8_t *fat = image[first];   // FAT sectors are contiguous in image
+        int offset = cluster + cluster / 2;
+        if (cluster & 1) {
+            fat[offset] = (fat[offset] & 0x0F) | ((value << 4) & 0xF0);
+            fat[offset + 1] = value >> 4;
+        } else {
+            fat[offset] = value;
+            fat[offset + 1] = (fat[offset + 1] & 0xF0) | ((value >> 8) & 0x0F);
+        }
+        dirty[first + offset / FLASH_SECTOR_SIZE] = true;
+        dirty[first + (offset + 1) / FLASH_SECTOR_SIZE] = true;
+    }
+}
+
+
+// Allocate a free cluster after the last allocated one, like FatFs does
+static int alloc_cluster(int prev) {
+    for (int n = 0; n < CLUSTER_NUM - 2; n++) {
+        int c = alloc_hint + n;
+        if (c >= CLUSTER_NUM) {
+            c -= CLUSTER_NUM - FIRST_FREE_CLUSTER;
+        }
+        if (fat_get(c) == 0) {
+            fat_set(c, 0xFFF);
+            if (prev) {
+                fat_set(prev, c);
+            }
+            alloc_hint = c + 1;
+            return c;
+        }
+    }
+    fprintf(stderr, "Disk full\n");
+    exit(1);
+}
+
+
+static void free_chain(int cluster) {
+    while (cluster >= 2 && cluster < 0xFF8) {
+        int next = fat_get(cluster);
+        fat_set(cluster, 0);
+        cluster = next;
+    }
+}
+
+
+// Update size, first cluster and time in the directory entry
+static void update_dir_entry(sim_file_t *f) {
+    uint8_t *entry = image[cluster_sector(f->dir_cluster)] + f->entry_offset;
+    uint16_t time = ((clock_minutes / 60 % 24) << 11) | ((clock_minutes % 60) << 5);
+    uint16_t date = ((clock_minutes / 1440 % 28 + 1)) | (1 << 5) | (45 << 9);
+    entry[0] = 'F';
+    entry[22] = time;
+    entry[23] = time >> 8;
+    entry[24] = date;
+    entry[25] = date >> 8;
+    entry[26] = f->first_cluster;
+    entry[27] = f->first_cluster >> 8;
+    memcpy(entry + 28, &f->size, 4);
+    dirty[cluster_sector(f->dir_cluster)] = true;
+}
+
+
+static void delete_file(sim_file_t *f) {
+    free_chain(f->first_cluster);
+    image[cluster_sector(f->dir_cluster)][f->entry_offset] = 0xE5;
+    dirty[cluster_sector(f->dir_cluster)] = true;
+    f->first_cluster = 0;
+    f->last_cluster = 0;
+    f->size = 0;
+}
+
+
+// Append data to file, bytes after the end of file keep their stale content
+static void append_file(sim_file_t *f, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (f->size % FLASH_SECTOR_SIZE == 0 && (f->size > 0 || f->first_cluster == 0)) {
+            int c = alloc_cluster(f->last_cluster);
+            if (!f->first_cluster) {
+                f->first_cluster = c;
+            }
+            f->last_cluster = c;
+        }
+        int sector = cluster_sector(f->last_cluster);
+        image[sector][f->size % FLASH_SECTOR_SIZE] = (i % 64 == 63) ? '\n' : ' ' + rand() % 95;
+        dirty[sector] = true;
+        f->size++;
+    }
+    update_dir_entry(f);
+}
+
+
+// Same logic as program_sector() in flash.c, return false if the sector waits for an erased one
+static bool write_sector(int sector, const uint8_t *data, bool force) {
+    uint32_t offset = ftl_get_sector_offset(sector);
+    const uint8_t *old = (const uint8_t *)(XIP_BASE + offset);
+    if (memcmp(old, data, FLASH_SECTOR_SIZE) == 0) {
+        host_writes++;
+        skipped_writes++;
+        return true;
+    }
+    bool need_erase = false;
+    for (int i = 0; i < FLASH_SECTOR_SIZE; i++) {
+        if ((old[i] & data[i]) != data[i]) {
+            need_erase = true;
+            break;
+        }
+    }
+    if (!need_erase) {
+        for (int i = 0; i < FLASH_SECTOR_SIZE; i += FLASH_PAGE_SIZE) {
+            if (memcmp(old + i, data + i, FLASH_PAGE_SIZE)) {
+                flash_range_program(offset + i, data + i, FLASH_PAGE_SIZE);
+            }
+        }
+        host_writes++;
+        in_place_writes++;
+        return true;
+    }
+    if (use_ftl && !force && !ftl_can_write_sector(false)) {
+        deferred_writes++;
+        return false;
+    }
+    host_writes++;
+    if (use_ftl && ftl_write_sector(sector, data, force)) {
+        return true;
+    }
+    flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    for (int i = 0; i < FLASH_SECTOR_SIZE; i += FLASH_PAGE_SIZE) {
+        flash_range_program(offset + i, data + i, FLASH_PAGE_SIZE);
+    }
+    return true;
+}
+
+
+// Total number of erases in the emulated flash
+static uint64_t total_erases(void) {
+    uint64_t total = 0;
+    for (int i = 0; i < SIM_FLASH_SECTORS; i++) {
+        total += sim_erase_count[i];
+    }
+    return total;
+}
+
+
+// Write back dirty sectors like a log flush does, then let the FTL work in idle time if allowed
+static void sync_and_idle(bool idle) {
+    uint64_t erases = total_erases();
+    sim_max_call_us = 0;
+    int waiting = 0;
+    for (int i = 0; i < FTL_LOGICAL_SECTORS; i++) {
+        if (dirty[i] && write_sector(i, image[i], false)) {
+            dirty[i] = false;
+        }
+        waiting += dirty[i];
+    }
+    // The cache cannot hold more, the rest is forced out like evicted cache entries
+    for (int i = 0; i < FTL_LOGICAL_SECTORS && waiting > CACHE_SECTORS; i++) {
+        if (dirty[i]) {
+            write_sector(i, image[i], true);
+            dirty[i] = false;
+            waiting--;
+        }
+    }
+    flush_erases += total_erases() - erases;
+    if (sim_max_call_us > max_flush_irq_off_us) {
+        max_flush_irq_off_us = sim_max_call_us;
+    }
+    if (use_ftl && idle) {
+        while (ftl_process());
+    }
+}
+
+
+// Create the same file system as flash_fatfs_init()
+static void format(void) {
+    for (int i = 0; i < FTL_LOGICAL_SECTORS; i++) {
+        memcpy(image[i], (const uint8_t *)(XIP_BASE + FLASH_FAT_OFFSET + i * FLASH_SECTOR_SIZE), FLASH_SECTOR_SIZE);
+    }
+    memset(image[BOOT_SECTOR], 0, FLASH_SECTOR_SIZE);
+    image[BOOT_SECTOR][510] = 0x55;
+    image[BOOT_SECTOR][511] = 0xAA;
+    for (int i = FAT1_SECTOR; i < DATA_SECTOR; i++) {
+        memset(image[i], 0, FLASH_SECTOR_SIZE);
+    }
+    for (int i = 0; i < 2; i++) {
+        uint8_t *fat = image[i ? FAT2_SECTOR : FAT1_SECTOR];
+        fat[0] = 0xF8;
+        fat[1] = 0xFF;
+        fat[2] = 0xFF;
+    }
+    for (int i = 0; i < DATA_SECTOR; i++) {
+        dirty[i] = true;
+    }
+    ftl_format();
+
+    // Directories for log and configuration
+    fat_set(LOG_DIR_CLUSTER, 0xFFF);
+    fat_set(CONF_DIR_CLUSTER, 0xFFF);
+    memset(image[cluster_sector(LOG_DIR_CLUSTER)], 0, FLASH_SECTOR_SIZE);
+    memset(image[cluster_sector(CONF_DIR_CLUSTER)], 0, FLASH_SECTOR_SIZE);
+    dirty[cluster_sector(LOG_DIR_CLUSTER)] = true;
+    dirty[cluster_sector(CONF_DIR_CLUSTER)] = true;
+    sync_and_idle(true);
+}
+
+
+int main(int argc, char *argv[]) {
+    int days = 365;
+    int interval = 10;
+    int bytes = 400;
+    int cap_kb = 1024;
+    int gc_every = 1;
+    const char *csv = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "nd:i:b:c:g:o:")) != -1) {
+        switch (opt) {
+            case 'n': use_ftl = false; break;
+            case 'd': days = atoi(optarg); break;
+            case 'i': interval = atoi(optarg); break;
+            case 'b': bytes = atoi(optarg); break;
+            case 'c': cap_kb = atoi(optarg); break;
+            case 'g': gc_every = atoi(optarg); break;
+            case 'o': csv = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n] [-d days] [-i minutes] [-b bytes] [-c KB] [-g flushes] [-o file.csv]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    image = malloc((size_t)FTL_LOGICAL_SECTORS * FLASH_SECTOR_SIZE);
+    srand(1);
+    flash_sim_reset();
+    ftl_init();
+    format();
+    memset(sim_erase_count, 0, sizeof(sim_erase_count));
+    sim_bytes_programmed = 0;
+    host_writes = skipped_writes = in_place_writes = deferred_writes = flush_erases = 0;
+    max_flush_irq_off_us = 0;
+
+    sim_file_t log_file = {.dir_cluster = LOG_DIR_CLUSTER, .entry_offset = 64};
+    sim_file_t conf_file = {.dir_cluster = CONF_DIR_CLUSTER, .entry_offset = 64};
+    uint64_t flushes = 0;
+
+    for (clock_minutes = 0; clock_minutes < (uint32_t)days * 1440; clock_minutes += interval) {
+        if (log_file.size >= (uint32_t)cap_kb * 1024) {
+            delete_file(&log_file);
+        }
+        append_file(&log_file, bytes);
+        flushes++;
+
+        if (clock_minutes % 1440 < (uint32_t)interval) {
+            // Configuration file is created again when saved
+            delete_file(&conf_file);
+            append_file(&conf_file, CONF_FILE_SIZE);
+        }
+        sync_and_idle(gc_every <= 1 || flushes % gc_every == 0);
+    }
+
+    // Collect erase counts of FAT region and tail area
+    int first = FLASH_FAT_OFFSET / FLASH_SECTOR_SIZE;
+    int last = SIM_FLASH_SECTORS;
+    uint64_t total = 0;
+    uint32_t max = 0;
+    int max_sector = first;
+    int used = 0;
+    for (int i = first; i < last; i++) {
+        total += sim_erase_count[i];
+        if (sim_erase_count[i] > max) {
+            max = sim_erase_count[i];
+            max_sector = i;
+        }
+        if (sim_erase_count[i]) {
+            used++;
+        }
+    }
+
+    printf("Mode:                  %s\n", use_ftl ? "FTL" : "in place");
+    printf("Simulated days:        %d\n", days);
+    printf("Log flushes:           %llu (%d bytes every %d minutes)\n", (unsigned long long)flushes, bytes, interval);
+    printf("Sector writes:         %llu (%llu skipped, %llu without erase)\n",
+           (unsigned long long)host_writes, (unsigned long long)skipped_writes, (unsigned long long)in_place_writes);
+    printf("Deferred writes:       %llu\n", (unsigned long long)deferred_writes);
+    printf("Erases while flushing: %llu\n", (unsigned long long)flush_erases);
+    printf("Max IRQ off in flush:  %u us\n", max_flush_irq_off_us);
+    printf("Total erases:          %llu\n", (unsigned long long)total);
+    printf("Bytes programmed:      %llu\n", (unsigned long long)sim_bytes_programmed);
+    printf("Sectors ever erased:   %d of %d\n", used, last - first);
+    printf("Mean erases/sector:    %.2f\n", (double)total / (last - first));
+    printf("Max erases/sector:     %u (flash offset 0x%06X)\n", max, max_sector * FLASH_SECTOR_SIZE);
+    if (max) {
+        printf("Years to 100k cycles:  %.1f\n", 100000.0 / max * days / 365);
+    }
+    if (use_ftl) {
+        ftl_stats_t stats;
+        ftl_get_stats(&stats);
+        printf("FTL relocations:       %u\n", stats.relocations);
+        printf("FTL wear levelings:    %u\n", stats.wear_levelings);
+        printf("FTL snapshots:         %u\n", stats.snapshots);
+        printf("Max IRQ off:           %u us\n", stats.max_irq_off_us);
+    }
+
+    if (csv) {
+        FILE *fp = fopen(csv, "w");
+        if (!fp) {
+            perror(csv);
+            return 1;
+        }
+        fprintf(fp, "offset,erases\n");
+        for (int i = first; i < last; i++) {
+            fprintf(fp, "0x%06X,%u\n", i * FLASH_SECTOR_SIZE, sim_erase_count[i]);
+        }
+        fclose(fp);
+    }
+
+    free(image);
+    return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef _HOST_HARDWARE_POWMAN_H_
+#define _HOST_HARDWARE_POWMAN_H_
+
+#include <pico/stdlib.h>
+
+// Wall clock in milliseconds since 1970, follows the modelled time (see bench_stubs.c)
+uint64_t powman_timer_get_ms(void);
+
+#endif
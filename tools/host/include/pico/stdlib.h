@@ -0,0 +1,51 @@
+#ifndef _HOST_PICO_STDLIB_H_
+#define _HOST_PICO_STDLIB_H_
+
+// Minimal replacement of the Pico SDK for building firmware sources on host
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+
+// RAM that is not initialized at boot is ordinary zeroed memory on host
+#define __uninitialized_ram(group) group
+
+#define SRAM_BASE   0x20000000u
+#define SRAM4_BASE  0x20040000u
+
+typedef uint64_t absolute_time_t;
+
+typedef struct stdio_driver {
+    int unused;
+} stdio_driver_t;
+
+extern stdio_driver_t stdio_usb;
+
+// Modelled time, advanced by the emulated flash operations
+uint64_t time_us_64(void);
+
+static inline uint32_t time_us_32(void) {
+    return (uint32_t)time_us_64();
+}
+
+static inline absolute_time_t get_absolute_time(void) {
+    return time_us_64();
+}
+
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) {
+    return (int64_t)(to - from);
+}
+
+static inline void stdio_flush(void) {
+    fflush(stdout);
+}
+
+static inline void stdio_set_driver_enabled(stdio_driver_t *driver, bool enabled) {
+    (void)driver;
+    (void)enabled;
+}
+
+#endif
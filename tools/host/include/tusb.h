@@ -0,0 +1,8 @@
+#ifndef _HOST_TUSB_H_
+#define _HOST_TUSB_H_
+
+// Nothing from TinyUSB is used by the firmware sources built on host
+
+#include <pico/stdlib.h>
+
+#endif
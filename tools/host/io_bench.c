@@ -0,0 +1,320 @@
+// Run real firmware storage workloads on emulated flash and report their cost
+//
+// flash.c, ftl.c, fatfs_disk.c, log.c, conf.c, script.c and FatFs are built unchanged,
+// only the flash chip is emulated in RAM (flash_sim.c). For every workload the number
+// of sector erases, bytes programmed and modelled time (erase and program time of the
+// flash) are reported, as well as the background work done in the next idle period and
+// the CPU time spent on host. Log saving is also reported per KB of log.
+//
+// At last a month of logging is simulated, to show how the cost of one log saving changes
+// as the log file grows: reopening the file for every saving (the end of file has to be
+// found by following its cluster chain) and keeping it open with size-capped rotation.
+//
+// Usage: io_bench [-r rounds] [-s KB] [-d days]
+//   -r  number of rounds for repeated workloads (default 100)
+//   -s  size of the file to copy in KB (default 256)
+//   -d  number of days of logging to simulate (default 30)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <ff.h>
+#include <hardware/powman.h>
+#include "flash_sim.h"
+#include "flash.h"
+#include "ftl.h"
+#include "fatfs_disk.h"
+#include "log.h"
+#include "conf.h"
+#include "script.h"
+
+
+#define LOG_LINES_PER_FLUSH     16
+
+#define IDLE_TIME_US            2000000
+#define IDLE_TASK_CALLS         4096
+
+#define LOG_FILE_PATH           "/log/WittyPi5.log"
+#define LOG_BIN_FILE_PATH       "/log/WittyPi5.wlg"
+
+#define SAVINGS_PER_DAY         240     // Every 6 minutes
+#define SAVING_INTERVAL_US      (86400000000ULL / SAVINGS_PER_DAY)
+
+#define COPY_SRC_PATH           "/schedule/bench.bin"
+#define COPY_DEST_PATH          "/schedule/bench.bak"
+
+
+typedef struct {
+    uint64_t erases;
+    uint64_t bytes_programmed;
+    uint64_t time_us;
+    uint64_t cpu_ns;
+} bench_counters_t;
+
+
+static int rounds = 100;
+
+static int copy_kb = 256;
+
+static int days = 30;
+
+static uint32_t log_bytes_saved = 0;
+
+
+static void read_counters(bench_counters_t *c) {
+    c->erases = 0;
+    for (int i = 0; i < SIM_FLASH_SECTORS; i++) {
+        c->erases += sim_erase_count[i];
+    }
+    c->bytes_programmed = sim_bytes_programmed;
+    c->time_us = sim_time_us;
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    c->cpu_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Let the flash task flush the cache and do background erasing, like the main loop does when idle
+static void run_idle(void) {
+    sim_time_us += IDLE_TIME_US;
+    for (int i = 0; i < IDLE_TASK_CALLS; i++) {
+        process_flash_task();
+    }
+}
+
+
+static void report(const char *name, int count, const bench_counters_t *before,
+                   const bench_counters_t *after, const bench_counters_t *idle) {
+    uint64_t erases = after->erases - before->erases;
+    uint64_t bytes = after->bytes_programmed - before->bytes_programmed;
+    uint64_t time_us = after->time_us - before->time_us;
+    uint64_t cpu_ns = after->cpu_ns - before->cpu_ns;
+    printf("%-26s %6d %9llu %12llu %11.1f %11.2f %11llu %9.2f\n", name, count,
+           (unsigned long long)erases, (unsigned long long)bytes,
+           time_us / 1000.0, (double)time_us / count / 1000.0,
+           (unsigned long long)(idle->erases - after->erases), cpu_ns / 1e6);
+    if (log_bytes_saved) {
+        double kb = log_bytes_saved / 1024.0;
+        printf("%-26s %6s %9.2f %12.0f %11.2f %11s %11s %9.3f\n", "  per KB of log", "",
+               erases / kb, bytes / kb, time_us / kb / 1000.0, "", "", cpu_ns / kb / 1e6);
+        log_bytes_saved = 0;
+    }
+}
+
+
+// Run a workload, make sure everything is written to flash, then let the firmware idle
+static void bench(const char *name, int count, void (*workload)(void)) {
+    bench_counters_t before, after, idle;
+    read_counters(&before);
+    workload();
+    flash_fatfs_flush(true);
+    read_counters(&after);
+    run_idle();
+    read_counters(&idle);
+    report(name, count, &before, &after, &idle);
+}
+
+
+static void factory_reset(void) {
+    unmount_fatfs();
+    flash_fatfs_init();
+    mount_fatfs();
+    create_default_dirs();
+}
+
+
+static uint32_t get_file_size(const char *path) {
+    FILINFO fno;
+    return f_stat(path, &fno) == FR_OK ? fno.fsize : 0;
+}
+
+
+static void write_log_lines(void) {
+    for (int i = 0; i < LOG_LINES_PER_FLUSH; i++) {
+        debug_log("Vin=%d.%02dV, Vout=%d.%02dV, Iout=%d.%03dA, Temp=%d.%dC\n",
+                  12, rand() % 100, 5, rand() % 100, 1, rand() % 1000, 25, rand() % 10);
+    }
+}
+
+
+static void write_logs(const char *path) {
+    uint32_t size = get_file_size(path);
+    for (int r = 0; r < rounds; r++) {
+        write_log_lines();
+        save_logs_to_file();
+    }
+    log_bytes_saved = get_file_size(path) - size;
+}
+
+
+static void save_logs(void) {
+    write_logs(LOG_FILE_PATH);
+}
+
+
+// Same log lines saved in binary format, the log task switches the format
+static void save_logs_binary(void) {
+    conf_set(CONF_LOG_FORMAT, 1);
+    process_log_task();
+    write_logs(LOG_BIN_FILE_PATH);
+    conf_set(CONF_LOG_FORMAT, 0);
+    process_log_task();
+}
+
+
+static void sync_conf(void) {
+    for (int r = 0; r < rounds; r++) {
+        conf_set(CONF_BLINK_LED, 50 + r % 100);
+        conf_sync();
+    }
+}
+
+
+// Changed value only goes into the journal of binary store, as the firmware does
+static void save_conf_binary(void) {
+    for (int r = 0; r < rounds; r++) {
+        conf_set(CONF_BLINK_LED, 50 + r % 100);
+        conf_save_binary();
+    }
+}
+
+
+static void convert_script(void) {
+    int64_t now = powman_timer_get_ms() / 1000 - TIMESTAMP_2000_01_01;
+    if (!convert_wpi_to_act(WPI_SCRIPT_PATH, ACT_SCRIPT_PATH, now) || !convert_act_to_skd(ACT_SCRIPT_PATH, SKD_SCRIPT_PATH)) {
+        fprintf(stderr, "Script conversion failed\n");
+        exit(1);
+    }
+}
+
+
+static void copy_file(void) {
+    if (!file_copy(COPY_DEST_PATH, COPY_SRC_PATH)) {
+        fprintf(stderr, "File copy failed\n");
+        exit(1);
+    }
+}
+
+
+static void write_file(const char *path, const void *data, size_t len) {
+    FIL fp;
+    UINT bw;
+    if (f_open(&fp, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK || f_write(&fp, data, len, &bw) != FR_OK || bw != len) {
+        fprintf(stderr, "Write file %s failed\n", path);
+        exit(1);
+    }
+    f_close(&fp);
+}
+
+
+// Save logs every few minutes for days on a freshly formatted disk, report the average cost of one saving per day
+static void log_month(const char *name, bool reopen, uint8_t size_limit) {
+    factory_reset();
+    conf_set(CONF_LOG_FILE_SIZE, size_limit);
+    double first_day_ms = 0;
+    double last_day_ms = 0;
+    for (int day = 1; day <= days; day++) {
+        bench_counters_t total = {0};
+        for (int i = 0; i < SAVINGS_PER_DAY; i++) {
+            write_log_lines();
+            if (reopen) {
+                close_log_file();
+            }
+            bench_counters_t before, after;
+            read_counters(&before);
+            save_logs_to_file();
+            flash_fatfs_flush(false);
+            read_counters(&after);
+            total.erases += after.erases - before.erases;
+            total.time_us += after.time_us - before.time_us;
+            total.cpu_ns += after.cpu_ns - before.cpu_ns;
+            sim_time_us += SAVING_INTERVAL_US;
+            for (int j = 0; j < 16; j++) {
+                process_flash_task();
+            }
+        }
+        last_day_ms = total.time_us / 1000.0 / SAVINGS_PER_DAY;
+        if (day == 1) {
+            first_day_ms = last_day_ms;
+        }
+        if (day == 1 || day == days || day % 7 == 0) {
+            printf("%-26s %6d %10u %9.2f %11.2f %11.1f\n", name, day, get_file_size(LOG_FILE_PATH) / 1024,
+                   (double)total.erases / SAVINGS_PER_DAY, total.time_us / 1000.0 / SAVINGS_PER_DAY,
+                   total.cpu_ns / 1000.0 / SAVINGS_PER_DAY);
+        }
+    }
+    if (first_day_ms > 0) {
+        printf("%-26s %6s %10s %9s %11.2f\n", "  last day / day 1", "", "", "", last_day_ms / first_day_ms);
+    }
+    close_log_file();
+}
+
+
+// Files used by the script and copy workloads, written before the measurement
+static void prepare_files(void) {
+    const char *wpi =
+        "# Turn on for 30 minutes every 6 hours\n"
+        "BEGIN 2025-01-01 00:00:00\n"
+        "END   2025-12-31 23:59:59\n"
+        "ON    M30\n"
+        "OFF   H5 M30\n";
+    write_file(WPI_SCRIPT_PATH, wpi, strlen(wpi));
+
+    size_t len = (size_t)copy_kb * 1024;
+    uint8_t *data = malloc(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = rand();
+    }
+    write_file(COPY_SRC_PATH, data, len);
+    free(data);
+    flash_fatfs_flush(true);
+    run_idle();
+}
+
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:d:")) != -1) {
+        switch (opt) {
+            case 'r': rounds = atoi(optarg); break;
+            case 's': copy_kb = atoi(optarg); break;
+            case 'd': days = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-r rounds] [-s KB] [-d days]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (rounds <= 0 || copy_kb <= 0 || days <= 0) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    srand(1);
+    flash_sim_reset();
+    ftl_init();
+
+    printf("%-26s %6s %9s %12s %11s %11s %11s %9s\n", "Workload", "Count", "Erases", "Programmed", "Time(ms)", "Each(ms)", "IdleErases", "CPU(ms)");
+    bench("flash_fatfs_init", 1, factory_reset);
+    conf_init();
+    prepare_files();
+    bench("save_logs_to_file", rounds, save_logs);
+    bench("save_logs_to_file(binary)", rounds, save_logs_binary);
+    bench("conf_sync", rounds, sync_conf);
+    bench("conf_save_binary", rounds, save_conf_binary);
+    bench("convert_wpi/act_to_skd", 1, convert_script);
+    bench("file_copy", 1, copy_file);
+
+    flash_stats_t stats;
+    flash_get_stats(&stats);
+    printf("\nErases avoided: %u, sectors skipped: %u, deferred: %u, relocated: %u, inline erases: %u, max IRQ off: %u us\n",
+           stats.erases_avoided, stats.sectors_skipped, stats.writes_deferred, stats.sectors_relocated, stats.erases, stats.max_irq_off_us);
+
+    printf("\nLog saving every %d minutes, %d lines each time (average of one saving in the day)\n",
+           24 * 60 / SAVINGS_PER_DAY, LOG_LINES_PER_FLUSH);
+    printf("%-26s %6s %10s %9s %11s %11s\n", "Mode", "Day", "File(KB)", "Erases", "Time(ms)", "CPU(us)");
+    log_month("reopen, no size limit", true, 0);
+    log_month("kept open, 1MB rotation", false, 16);
+    return 0;
+}
@@ -0,0 +1,250 @@
+// Decode binary log file (WittyPi5.wlg) into the same text as WittyPi5.log
+//
+// Message ids are looked up in the table generated by tools/log_formats.py from the
+// firmware sources, so the table must come from the same firmware version that wrote
+// the log. Decoding stops at the first message with unknown id, as its arguments
+// can't be skipped.
+//
+// Usage: log_decode <WittyPi5.wlg>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "log_format.h"
+
+
+#define MAX_MESSAGE_SIZE    256
+#define MAX_SPEC_LENGTH     16
+
+
+typedef struct {
+    uint32_t id;
+    const char *format;
+} format_entry_t;
+
+
+extern const char *const log_formats[];
+extern const int log_format_count;
+
+static format_entry_t *format_table;
+
+
+static int compare_entries(const void *a, const void *b) {
+    uint32_t ia = ((const format_entry_t *)a)->id;
+    uint32_t ib = ((const format_entry_t *)b)->id;
+    return ia < ib ? -1 : ia > ib;
+}
+
+
+static const char *find_format(uint32_t id) {
+    format_entry_t key = {.id = id};
+    format_entry_t *entry = bsearch(&key, format_table, log_format_count, sizeof(format_entry_t), compare_entries);
+    return entry ? entry->format : NULL;
+}
+
+
+static void print_time_header(int64_t ms_timestamp) {
+    time_t t = ms_timestamp / 1000;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    printf("[%02d-%02d %02d:%02d:%02d.%03d] ", tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(ms_timestamp % 1000));
+}
+
+
+// Format a message like log.c does, return the number of bytes of arguments, or -1 if the data is broken
+static long format_message(const char *format, const uint8_t *data, size_t len, char *buf, int size) {
+    const uint8_t *start = data;
+    const uint8_t *end = data + len;
+    int pos = 0;
+    const char *p = format;
+    while (*p) {
+        if (*p != '%') {
+            if (pos < size - 1) {
+                buf[pos++] = *p;
+            }
+            p++;
+            continue;
+        }
+        log_arg_t arg;
+        bool is_signed;
+        const char *conv = log_parse_spec(p + 1, &arg, &is_signed);
+        if (arg == LOG_ARG_NONE) {
+            if (pos < size - 1) {
+                buf[pos++] = '%';
+            }
+            p = conv + 1;
+            continue;
+        }
+        if (arg == LOG_ARG_UNSUPPORTED) {
+            return -1;
+        }
+
+        // Specification without length modifier, integers are always printed as long long
+        char spec[MAX_SPEC_LENGTH];
+        int spec_len = 0;
+        int shorts = 0;
+        for (const char *q = p; q < conv && spec_len < MAX_SPEC_LENGTH - 4; q++) {
+            if (*q == 'h') {
+                shorts++;
+            } else if (*q != 'l' && *q != 'z') {
+                spec[spec_len++] = *q;
+            }
+        }
+        if (arg != LOG_ARG_STRING && *conv != 'c') {
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+        }
+        spec[spec_len++] = *conv;
+        spec[spec_len] = '\0';
+
+        int n;
+        if (arg == LOG_ARG_STRING) {
+            const uint8_t *nul = memchr(data, '\0', end - data);
+            if (!nul) {
+                return -1;
+            }
+            n = snprintf(buf + pos, size - pos, spec, (const char *)data);
+            data = nul + 1;
+        } else {
+            uint64_t v;
+            int used = log_get_varint(data, end - data, &v);
+            if (used == 0) {
+                return -1;
+            }
+            data += used;
+            if (is_signed) {
+                v = (v >> 1) ^ (0 - (v & 1));
+            }
+            if (shorts >= 2) {
+                v = is_signed ? (uint64_t)(int64_t)(int8_t)v : (uint8_t)v;
+            } else if (shorts == 1) {
+                v = is_signed ? (uint64_t)(int64_t)(int16_t)v : (uint16_t)v;
+            } else if (arg != LOG_ARG_LONG_LONG) {
+                v = is_signed ? (uint64_t)(int64_t)(int32_t)v : (uint32_t)v;
+            }
+            if (*conv == 'c') {
+                n = snprintf(buf + pos, size - pos, spec, (int)v);
+            } else {
+                n = snprintf(buf + pos, size - pos, spec, (unsigned long long)v);
+            }
+        }
+        if (n > 0) {
+            pos += n;
+            if (pos > size - 1) {
+                pos = size - 1;
+            }
+        }
+        p = conv + 1;
+    }
+    buf[pos] = '\0';
+    return data - start;
+}
+
+
+static int decode(const uint8_t *data, size_t len) {
+    if (len < LOG_BIN_MAGIC_SIZE || memcmp(data, LOG_BIN_MAGIC, LOG_BIN_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "Not a binary log file\n");
+        return 1;
+    }
+    size_t pos = LOG_BIN_MAGIC_SIZE;
+    int64_t timestamp = 0;
+    while (pos < len) {
+        uint64_t tag;
+        int used = log_get_varint(data + pos, len - pos, &tag);
+        if (used == 0) {
+            break;
+        }
+        pos += used;
+        timestamp += tag >> LOG_BIN_KIND_BITS;
+
+        int kind = tag & LOG_BIN_KIND_MASK;
+        if (kind == LOG_BIN_TIME) {
+            if (len - pos < 8) {
+                break;
+            }
+            timestamp = 0;
+            for (int i = 0; i < 8; i++) {
+                timestamp |= (int64_t)data[pos + i] << (8 * i);
+            }
+            pos += 8;
+        } else if (kind == LOG_BIN_TEXT) {
+            uint64_t text_len;
+            used = log_get_varint(data + pos, len - pos, &text_len);
+            if (used == 0 || text_len > len - pos - used) {
+                break;
+            }
+            pos += used;
+            print_time_header(timestamp);
+            fwrite(data + pos, 1, text_len, stdout);
+            pos += text_len;
+        } else if (kind == LOG_BIN_MESSAGE) {
+            if (len - pos < LOG_BIN_ID_SIZE) {
+                break;
+            }
+            uint32_t id = 0;
+            for (int i = 0; i < LOG_BIN_ID_SIZE; i++) {
+                id |= (uint32_t)data[pos + i] << (8 * i);
+            }
+            pos += LOG_BIN_ID_SIZE;
+            const char *format = find_format(id);
+            if (!format) {
+                // Arguments can't be skipped without the format, nothing after this can be decoded
+                print_time_header(timestamp);
+                printf("<unknown message 0x%06X>\n", id);
+                fprintf(stderr, "Unknown message id 0x%06X at offset %zu\n", id, pos - LOG_BIN_ID_SIZE);
+                return 1;
+            }
+            char text[MAX_MESSAGE_SIZE + 1];
+            long args_len = format_message(format, data + pos, len - pos, text, sizeof(text));
+            if (args_len < 0) {
+                break;
+            }
+            pos += args_len;
+            print_time_header(timestamp);
+            fputs(text, stdout);
+        } else {
+            fprintf(stderr, "Unknown event kind %d at offset %zu\n", kind, pos - used);
+            return 1;
+        }
+    }
+    if (pos < len) {
+        fprintf(stderr, "Truncated event at offset %zu\n", pos);
+        return 1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <WittyPi5.wlg>\n", argv[0]);
+        return 1;
+    }
+    format_table = malloc(sizeof(format_entry_t) * (log_format_count > 0 ? log_format_count : 1));
+    for (int i = 0; i < log_format_count; i++) {
+        format_table[i].id = log_format_id(log_formats[i]);
+        format_table[i].format = log_formats[i];
+    }
+    qsort(format_table, log_format_count, sizeof(format_entry_t), compare_entries);
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(len > 0 ? len : 1);
+    if (!data || fread(data, 1, len, f) != (size_t)len) {
+        fprintf(stderr, "Read %s failed\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+
+    int ret = decode(data, len);
+    free(data);
+    return ret;
+}
@@ -0,0 +1,97 @@
+// Measure the cost of formatting the time header of log messages
+//
+// Timestamps of a logging burst (a few ms to a second apart, running over several days)
+// are formatted by calculating the calendar date for every message, as the firmware
+// used to do, and by log_format_time() that only calculates it when the day changes.
+// Both must give the same text. calendar.c is built unchanged from the firmware sources.
+//
+// Usage: log_time_bench [-n count]
+//   -n  number of timestamps to format (default 1000000)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "log_time.h"
+
+
+#define BENCH_EPOCH_MS      1735689600000LL     // 2025-01-01 00:00:00
+#define MAX_STEP_MS         1000
+
+
+static uint64_t cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// The firmware before caching the day
+static void format_time_full(int64_t ms_timestamp, char *buf) {
+    int32_t millisec = ms_timestamp % 1000;
+    DateTime dt;
+    timestamp_to_datetime(ms_timestamp / 1000 - TIMESTAMP_2000_01_01, &dt);
+    sprintf(buf, "%02d-%02d %02d:%02d:%02d.%03d", dt.month, dt.day, dt.hour, dt.min, dt.sec, millisec);
+}
+
+
+int main(int argc, char *argv[]) {
+    int count = 1000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n': count = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-n count]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (count <= 0) {
+        fprintf(stderr, "Invalid arguments\n");
+        return 1;
+    }
+
+    int64_t *timestamps = malloc(sizeof(int64_t) * count);
+    char (*full)[LOG_TIME_LENGTH + 1] = malloc((size_t)count * (LOG_TIME_LENGTH + 1));
+    char (*cached)[LOG_TIME_LENGTH + 1] = malloc((size_t)count * (LOG_TIME_LENGTH + 1));
+    if (!timestamps || !full || !cached) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    srand(1);
+    int64_t t = BENCH_EPOCH_MS;
+    for (int i = 0; i < count; i++) {
+        t += rand() % MAX_STEP_MS;
+        timestamps[i] = t;
+    }
+
+    uint64_t start = cpu_ns();
+    for (int i = 0; i < count; i++) {
+        format_time_full(timestamps[i], full[i]);
+    }
+    uint64_t full_ns = cpu_ns() - start;
+
+    log_day_t day = {0};
+    start = cpu_ns();
+    for (int i = 0; i < count; i++) {
+        log_format_time(&day, timestamps[i], cached[i]);
+    }
+    uint64_t cached_ns = cpu_ns() - start;
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(full[i], cached[i]) != 0) {
+            fprintf(stderr, "Mismatch at %lld: \"%s\" != \"%s\"\n", (long long)timestamps[i], cached[i], full[i]);
+            return 1;
+        }
+    }
+
+    printf("%d timestamps over %.1f days\n", count, (t - BENCH_EPOCH_MS) / (double)LOG_MS_PER_DAY);
+    printf("%-26s %11s %11s\n", "Method", "Total(ms)", "Each(ns)");
+    printf("%-26s %11.1f %11.1f\n", "calendar for every line", full_ns / 1e6, (double)full_ns / count);
+    printf("%-26s %11.1f %11.1f\n", "cached day", cached_ns / 1e6, (double)cached_ns / count);
+    free(timestamps);
+    free(full);
+    free(cached);
+    return 0;
+}
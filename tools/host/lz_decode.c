@@ -0,0 +1,131 @@
+// Decompress log files compressed by the firmware (/log/*.lz)
+//
+// The format is described in src/lz.h. The output is the original log file: text for
+// WP5Log?.lz, binary log for WP5Wlg?.lz (decode it further with log_decode).
+//
+// Usage: lz_decode <file.lz> [output]
+//   the output goes to stdout if no output file is given
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lz.h"
+
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;         // Position in bits
+} bit_reader_t;
+
+
+// Read bits most significant bit first, return -1 at the end of data
+static long get_bits(bit_reader_t *r, int count) {
+    if (r->pos + count > r->len * 8) {
+        return -1;
+    }
+    long v = 0;
+    for (int i = 0; i < count; i++) {
+        v = (v << 1) | ((r->data[r->pos >> 3] >> (7 - (r->pos & 7))) & 1);
+        r->pos++;
+    }
+    return v;
+}
+
+
+static int decode(const uint8_t *data, size_t len, FILE *out) {
+    if (len < LZ_HEADER_SIZE || memcmp(data, LZ_MAGIC, LZ_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "Not a compressed log file\n");
+        return 1;
+    }
+    int window_bits = data[LZ_MAGIC_SIZE];
+    int length_bits = data[LZ_MAGIC_SIZE + 1];
+    if (window_bits < 1 || window_bits > 16 || length_bits < 1 || length_bits > 8) {
+        fprintf(stderr, "Unsupported parameters: window bits %d, length bits %d\n", window_bits, length_bits);
+        return 1;
+    }
+    uint32_t size = 0;
+    for (int i = 0; i < 4; i++) {
+        size |= (uint32_t)data[LZ_MAGIC_SIZE + 2 + i] << (8 * i);
+    }
+
+    uint8_t *output = malloc(size ? size : 1);
+    if (!output) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    bit_reader_t r = {.data = data + LZ_HEADER_SIZE, .len = len - LZ_HEADER_SIZE, .pos = 0};
+    uint32_t n = 0;
+    while (n < size) {
+        long flag = get_bits(&r, 1);
+        if (flag == 1) {
+            long byte = get_bits(&r, 8);
+            if (byte < 0) {
+                break;
+            }
+            output[n++] = (uint8_t)byte;
+            continue;
+        }
+        long distance = get_bits(&r, window_bits);
+        long length = get_bits(&r, length_bits);
+        if (flag < 0 || distance < 0 || length < 0) {
+            break;
+        }
+        distance += 1;
+        length += LZ_MIN_MATCH;
+        if (distance > n || length > size - n) {
+            fprintf(stderr, "Invalid copy at output offset %u\n", n);
+            free(output);
+            return 1;
+        }
+        for (long i = 0; i < length; i++, n++) {
+            output[n] = output[n - distance];
+        }
+    }
+    fwrite(output, 1, n, out);
+    free(output);
+    if (n < size) {
+        fprintf(stderr, "Truncated file, %u of %u bytes decoded\n", n, size);
+        return 1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "Usage: %s <file.lz> [output]\n", argv[0]);
+        return 1;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(len > 0 ? len : 1);
+    if (!data || fread(data, 1, len, f) != (size_t)len) {
+        fprintf(stderr, "Read %s failed\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+
+    FILE *out = stdout;
+    if (argc == 3) {
+        out = fopen(argv[2], "wb");
+        if (!out) {
+            perror(argv[2]);
+            free(data);
+            return 1;
+        }
+    }
+    int ret = decode(data, len, out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    free(data);
+    return ret;
+}
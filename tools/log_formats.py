@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+# Generate the message table of binary log from debug_log() call sites
+#
+# Every format string literal passed to debug_log() or log_debug/info/warn/error() is
+# collected (with the level letter and module tag that these macros add), and its message id
+# is computed the same way as log_format_id() in src/log_format.h. The table is used by
+# tools/host/log_decode.c to turn binary log back into text. Exits with error if two
+# different format strings get the same id, so the build fails before it can happen.
+#
+# Usage: log_formats.py <output.c> <source files...>
+
+import re
+import sys
+
+
+CALL_RE = re.compile(r'\b(debug_log|log_debug|log_info|log_warn|log_error)\s*\(\s*((?:"(?:[^"\\\n]|\\.)*"\s*)+)[,)]')
+MODULE_RE = re.compile(r'^#define\s+LOG_MODULE\s+"((?:[^"\\\n]|\\.)*)"', re.M)
+LITERAL_RE = re.compile(r'"((?:[^"\\\n]|\\.)*)"')
+
+LEVEL_LETTERS = {'log_debug': 'D', 'log_info': 'I', 'log_warn': 'W', 'log_error': 'E'}
+
+ESCAPES = {'n': '\n', 't': '\t', 'r': '\r', '0': '\0', '\\': '\\', '"': '"', "'": "'"}
+
+
+def unescape(literal):
+    out = bytearray()
+    i = 0
+    while i < len(literal):
+        c = literal[i]
+        if c == '\\':
+            i += 1
+            e = literal[i]
+            if e == 'x':
+                m = re.match(r'[0-9a-fA-F]+', literal[i + 1:])
+                out.append(int(m.group(0), 16) & 0xFF)
+                i += len(m.group(0))
+            elif e in '01234567':
+                m = re.match(r'[0-7]{1,3}', literal[i:])
+                out.append(int(m.group(0), 8) & 0xFF)
+                i += len(m.group(0)) - 1
+            else:
+                out += ESCAPES.get(e, e).encode()
+        else:
+            out += c.encode()
+        i += 1
+    return bytes(out)
+
+
+def format_id(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return (h ^ (h >> 24)) & 0xFFFFFF
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.stderr.write('Usage: %s <output.c> <source files...>\n' % sys.argv[0])
+        return 1
+
+    formats = {}    # unescaped format -> literal as in source
+    for path in sys.argv[2:]:
+        with open(path, encoding='utf-8', errors='replace') as f:
+            source = f.read()
+        module = MODULE_RE.search(source)
+        for m in CALL_RE.finditer(source):
+            literals = LITERAL_RE.findall(m.group(2))
+            if m.group(1) in LEVEL_LETTERS:
+                if not module:
+                    sys.stderr.write('%s: LOG_MODULE is not defined\n' % path)
+                    return 1
+                literals.insert(0, '%s %s: ' % (LEVEL_LETTERS[m.group(1)], module.group(1)))
+            formats.setdefault(unescape(''.join(literals)), ' '.join('"%s"' % l for l in literals))
+
+    ids = {}
+    for data in formats:
+        ids.setdefault(format_id(data), []).append(data)
+    collisions = [v for v in ids.values() if len(v) > 1]
+    for v in collisions:
+        sys.stderr.write('Log message id 0x%06X collision:\n' % format_id(v[0]))
+        for data in v:
+            sys.stderr.write('    %s\n' % formats[data])
+    if collisions:
+        return 1
+
+    with open(sys.argv[1], 'w') as f:
+        f.write('// Generated by tools/log_formats.py, do not edit\n\n')
+        f.write('const char *const log_formats[] = {\n')
+        for data in sorted(formats, key=format_id):
+            f.write('    %s,\n' % formats[data])
+        f.write('};\n\n')
+        f.write('const int log_format_count = %d;\n' % len(formats))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,58 @@
+#!/bin/bash
+#
+# Measure the throughput of copying a file to the Witty Pi 5 USB drive
+#
+# Usage: msc_write_bench.sh <mount point> [size in KB, default 1024] [runs, default 3]
+#
+# Run it on the Raspberry Pi with the Witty Pi 5 USB drive mounted, once with
+# the old firmware and once with the new one to compare. The median of the runs
+# is printed last.
+
+MOUNT_POINT="$1"
+SIZE_KB="${2:-1024}"
+RUNS="${3:-3}"
+
+if [ -z "$MOUNT_POINT" ] || [ ! -d "$MOUNT_POINT" ]; then
+  echo "Usage: $0 <mount point> [size in KB] [runs]"
+  exit 1
+fi
+
+SRC=$(mktemp)
+DEST="$MOUNT_POINT/bench.bin"
+trap 'rm -f "$SRC" "$DEST"; sync' EXIT
+
+dd if=/dev/urandom of="$SRC" bs=1024 count="$SIZE_KB" status=none
+
+TIMES=()
+for ((i = 1; i <= RUNS; i++)); do
+  rm -f "$DEST"
+  sync
+  START=$(date +%s.%N)
+  cp "$SRC" "$DEST"
+  sync "$DEST"
+  END=$(date +%s.%N)
+
+  T=$(awk -v s="$START" -v e="$END" 'BEGIN { printf "%.3f", e - s }')
+  TIMES+=("$T")
+  awk -v i="$i" -v kb="$SIZE_KB" -v t="$T" 'BEGIN {
+    printf "Run %d: copied %d KB in %.2f s: %.3f MB/s\n", i, kb, t, kb / 1024 / t
+  }'
+
+  # Read back from the drive instead of page cache if possible
+  if [ "$EUID" -eq 0 ]; then
+    echo 3 > /proc/sys/vm/drop_caches
+  fi
+
+  if ! cmp -s "$SRC" "$DEST"; then
+    echo "Verify: FAILED"
+    exit 1
+  fi
+done
+echo "Verify: OK"
+
+printf '%s\n' "${TIMES[@]}" | sort -n | awk -v kb="$SIZE_KB" '
+  { t[NR] = $1 }
+  END {
+    m = (NR % 2) ? t[(NR + 1) / 2] : (t[NR / 2] + t[NR / 2 + 1]) / 2
+    printf "Median of %d runs: %.2f s, %.3f MB/s\n", NR, m, kb / 1024 / m
+  }'